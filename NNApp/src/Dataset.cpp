@@ -0,0 +1,54 @@
+#include "pch.h"
+#include "Dataset.h"
+
+#include <cassert>
+#define expect(x) assert(x)
+
+namespace NN
+{
+    std::shared_ptr<const Dataset> Dataset::create(const TrainingSet& trainingSet)
+    {
+        expect(trainingSet.size() > 0);
+
+        auto dataset = std::make_shared<Dataset>();
+        dataset->countRows = trainingSet.size();
+        dataset->inputSize = trainingSet.front().first.size();
+        dataset->answerSize = trainingSet.front().second.size();
+
+        dataset->inputs.reserve(dataset->countRows * dataset->inputSize);
+        dataset->answers.reserve(dataset->countRows * dataset->answerSize);
+
+        for (const auto& ts : trainingSet)
+        {
+            expect(ts.first.size() == dataset->inputSize);
+            expect(ts.second.size() == dataset->answerSize);
+
+            dataset->inputs.insert(dataset->inputs.end(), ts.first.begin(), ts.first.end());
+            dataset->answers.insert(dataset->answers.end(), ts.second.begin(), ts.second.end());
+        }
+
+        return dataset;
+    }
+    size_t Dataset::size() const
+    {
+        return countRows;
+    }
+    size_t Dataset::getInputSize() const
+    {
+        return inputSize;
+    }
+    size_t Dataset::getAnswerSize() const
+    {
+        return answerSize;
+    }
+    const double* Dataset::getInput(size_t row) const
+    {
+        expect(row < countRows);
+        return inputs.data() + row * inputSize;
+    }
+    const double* Dataset::getAnswer(size_t row) const
+    {
+        expect(row < countRows);
+        return answers.data() + row * answerSize;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+
+namespace NN
+{
+    /* Read-only training set in contiguous row-major storage, shared between trainers without copies */
+    class Dataset
+    {
+    public:
+        using TrainingSet = std::vector<std::pair<std::vector<double>, std::vector<double>>>;
+
+    public:
+        static std::shared_ptr<const Dataset> create(const TrainingSet& trainingSet);
+        size_t size() const;
+        size_t getInputSize() const;
+        size_t getAnswerSize() const;
+        const double* getInput(size_t row) const;
+        const double* getAnswer(size_t row) const;
+
+    private:
+        size_t countRows = 0;
+        size_t inputSize = 0;
+        size_t answerSize = 0;
+        std::vector<double> inputs;
+        std::vector<double> answers;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,363 @@
+#include "pch.h"
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include "InferenceServer.h"
+
+#include <sstream>
+#include <algorithm>
+#include <cstdlib>
+#include <cassert>
+#define expect(x) assert(x)
+
+namespace NN
+{
+    InferenceServer::InferenceServer(NeuralNetwork& nn, Config config)
+        :
+        nn(nn),
+        config(config),
+        engine(nn, nullptr, NumaEngine::Options()),
+        listenSocket(INVALID_SOCKET),
+        startTime(Clock::now())
+    {
+        expect(config.maxBatchSize > 0);
+        expect(nn.getLayers().size() > 1);
+
+        batchThread = std::thread(&InferenceServer::p_batchLoop, this);
+    }
+    InferenceServer::~InferenceServer()
+    {
+        stop();
+
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            isStopping = true;
+        }
+        queueCv.notify_all();
+
+        batchThread.join();
+    }
+    bool InferenceServer::run()
+    {
+        WSADATA wsaData;
+        if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+            return false;
+
+        SOCKET server = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (server == INVALID_SOCKET)
+        {
+            WSACleanup();
+            return false;
+        }
+
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(config.port);
+        inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+
+        if (bind(server, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR
+            || listen(server, SOMAXCONN) == SOCKET_ERROR)
+        {
+            closesocket(server);
+            WSACleanup();
+            return false;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(clientsMutex);
+            listenSocket = server;
+            isRunning = true;
+        }
+
+        while (isRunning)
+        {
+            SOCKET client = accept(server, nullptr, nullptr);
+            if (client == INVALID_SOCKET)
+                break;
+
+            /* Small request lines must not wait for Nagle */
+            BOOL noDelay = TRUE;
+            setsockopt(client, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+
+            p_joinFinishedClients();
+
+            std::lock_guard<std::mutex> lock(clientsMutex);
+            clientSockets.push_back(client);
+            clientThreads.emplace_back(&InferenceServer::p_serveClient, this, client);
+        }
+
+        stop();
+
+        /* Unblocks the client threads waiting in recv */
+        std::vector<std::thread> threads;
+        {
+            std::lock_guard<std::mutex> lock(clientsMutex);
+            for (auto client : clientSockets)
+                shutdown(client, SD_BOTH);
+
+            threads = std::move(clientThreads);
+            finishedClients.clear();
+        }
+
+        for (auto& thread : threads)
+            thread.join();
+
+        WSACleanup();
+        return true;
+    }
+    void InferenceServer::stop()
+    {
+        std::lock_guard<std::mutex> lock(clientsMutex);
+
+        if (!isRunning)
+            return;
+
+        /* Closing the listening socket makes accept fail and run return */
+        isRunning = false;
+        closesocket(listenSocket);
+        listenSocket = INVALID_SOCKET;
+    }
+    std::vector<double> InferenceServer::classify(std::vector<double> input)
+    {
+        Request request;
+        request.input = std::move(input);
+        request.arrival = Clock::now();
+        auto output = request.output.get_future();
+
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            queue.push_back(std::move(request));
+        }
+        queueCv.notify_all();
+
+        return output.get();
+    }
+    InferenceServer::Stats InferenceServer::getStats() const
+    {
+        std::lock_guard<std::mutex> lock(statsMutex);
+
+        Stats stats;
+        stats.countRequests = countRequests;
+        stats.countBatches = countBatches;
+
+        if (countBatches > 0)
+            stats.averageBatchSize = static_cast<double>(countRequests) / countBatches;
+
+        if (countRequests > 0)
+            stats.averageQueueLatency = totalQueueLatency / countRequests;
+
+        stats.maxQueueLatency = maxQueueLatency;
+        stats.countNodes = engine.getCountNodes();
+        stats.countWorkers = engine.getCountWorkers();
+        stats.engine = engine.getCounters();
+
+        std::chrono::duration<double> uptime = Clock::now() - startTime;
+        if (uptime.count() > 0)
+            stats.throughput = countRequests / uptime.count();
+
+        return stats;
+    }
+    void InferenceServer::p_batchLoop()
+    {
+        while (true)
+        {
+            std::vector<Request> batch;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                queueCv.wait(lock, [&] { return isStopping || !queue.empty(); });
+
+                if (queue.empty())
+                    return;
+
+                /* The oldest request bounds how long the batch may keep filling */
+                auto deadline = queue.front().arrival + config.maxLatency;
+                queueCv.wait_until(lock, deadline, [&] { return isStopping || queue.size() >= config.maxBatchSize; });
+
+                size_t count = std::min(queue.size(), config.maxBatchSize);
+                for (size_t i = 0; i < count; i++)
+                {
+                    batch.push_back(std::move(queue.front()));
+                    queue.pop_front();
+                }
+            }
+
+            p_processBatch(batch);
+        }
+    }
+    void InferenceServer::p_processBatch(std::vector<Request>& batch)
+    {
+        const auto& layers = nn.getLayers();
+        const size_t inputSize = layers.front();
+        const size_t outputSize = layers.back();
+
+        /* Malformed requests get an empty answer and stay out of the forward pass */
+        std::vector<Request*> valid;
+        for (auto& request : batch)
+        {
+            if (request.input.size() == inputSize)
+                valid.push_back(&request);
+            else
+                request.output.set_value({});
+        }
+
+        auto batchStart = Clock::now();
+
+        if (!valid.empty())
+        {
+            std::vector<double> inputs;
+            inputs.reserve(valid.size() * inputSize);
+            for (auto request : valid)
+                inputs.insert(inputs.end(), request->input.begin(), request->input.end());
+
+            auto outputs = engine.classifyBatch(inputs.data(), valid.size());
+
+            for (size_t i = 0; i < valid.size(); i++)
+            {
+                auto begin = outputs.begin() + i * outputSize;
+                valid[i]->output.set_value(std::vector<double>(begin, begin + outputSize));
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(statsMutex);
+        countBatches++;
+        countRequests += batch.size();
+
+        for (const auto& request : batch)
+        {
+            std::chrono::duration<double> latency = batchStart - request.arrival;
+            totalQueueLatency += latency.count();
+            maxQueueLatency = std::max(maxQueueLatency, latency.count());
+        }
+    }
+    void InferenceServer::p_serveClient(uintptr_t clientSocket)
+    {
+        SOCKET client = static_cast<SOCKET>(clientSocket);
+        std::string pending;
+        char buffer[4096];
+        bool isConnected = true;
+
+        while (isConnected)
+        {
+            int received = recv(client, buffer, sizeof(buffer), 0);
+            if (received <= 0)
+                break;
+
+            pending.append(buffer, received);
+
+            size_t lineEnd;
+            while (isConnected && (lineEnd = pending.find('\n')) != std::string::npos)
+            {
+                std::string line = pending.substr(0, lineEnd);
+                pending.erase(0, lineEnd + 1);
+
+                if (!line.empty() && line.back() == '\r')
+                    line.pop_back();
+
+                isConnected = p_sendAll(clientSocket, p_handleLine(line) + "\n");
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        clientSockets.erase(std::remove(clientSockets.begin(), clientSockets.end(), clientSocket), clientSockets.end());
+        closesocket(client);
+        finishedClients.push_back(std::this_thread::get_id());
+    }
+    void InferenceServer::p_joinFinishedClients()
+    {
+        /* Without this every connection ever served would keep its thread handle */
+        std::vector<std::thread> finished;
+        {
+            std::lock_guard<std::mutex> lock(clientsMutex);
+
+            for (auto id : finishedClients)
+            {
+                auto thread = std::find_if(clientThreads.begin(), clientThreads.end(), [&](const std::thread& t) { return t.get_id() == id; });
+                if (thread == clientThreads.end())
+                    continue;
+
+                finished.push_back(std::move(*thread));
+                clientThreads.erase(thread);
+            }
+
+            finishedClients.clear();
+        }
+
+        for (auto& thread : finished)
+            thread.join();
+    }
+    bool InferenceServer::p_sendAll(uintptr_t clientSocket, const std::string& data)
+    {
+        /* send may take only a part of the reply */
+        SOCKET client = static_cast<SOCKET>(clientSocket);
+        size_t countSent = 0;
+
+        while (countSent < data.size())
+        {
+            int sent = send(client, data.data() + countSent, static_cast<int>(data.size() - countSent), 0);
+            if (sent <= 0)
+                return false;
+
+            countSent += sent;
+        }
+
+        return true;
+    }
+    std::string InferenceServer::p_handleLine(const std::string& line)
+    {
+        if (line == "STATS")
+            return p_formatStats(getStats());
+
+        std::vector<double> input;
+        const char* begin = line.c_str();
+
+        while (*begin != '\0')
+        {
+            char* end = nullptr;
+            double value = std::strtod(begin, &end);
+            if (end == begin)
+                return "ERROR";
+
+            input.push_back(value);
+            begin = end;
+
+            if (*begin == ',')
+                begin++;
+        }
+
+        auto output = classify(std::move(input));
+        if (output.empty())
+            return "ERROR";
+
+        return p_formatVector(output);
+    }
+    std::string InferenceServer::p_formatVector(const std::vector<double>& vector)
+    {
+        std::ostringstream ss;
+        ss.precision(17);
+
+        for (size_t i = 0; i < vector.size(); i++)
+        {
+            ss << vector[i];
+            if (i != vector.size() - 1)
+                ss << ',';
+        }
+
+        return ss.str();
+    }
+    std::string InferenceServer::p_formatStats(const Stats& stats)
+    {
+        std::ostringstream ss;
+        ss << "requests=" << stats.countRequests
+            << " batches=" << stats.countBatches
+            << " avgBatch=" << stats.averageBatchSize
+            << " avgQueueUs=" << stats.averageQueueLatency * 1e6
+            << " maxQueueUs=" << stats.maxQueueLatency * 1e6
+            << " qps=" << stats.throughput
+            << " nodes=" << stats.countNodes
+            << " workers=" << stats.countWorkers
+            << " unpinned=" << stats.engine.countUnpinnedWorkers
+            << " crossNodeBytes=" << stats.engine.crossNodeInferenceBytes;
+
+        return ss.str();
+    }
+}
\ No newline at end of file
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <future>
+#include <chrono>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include "NeuralNetwork.h"
+#include "NumaEngine.h"
+
+namespace NN
+{
+    /* Headless classification server on localhost TCP.
+       Protocol is line based: a comma separated input vector is answered with the comma separated
+       output vector, "STATS" is answered with the counters. Requests of all connections are collected
+       into micro-batches bounded by maxBatchSize and maxLatency, every micro-batch is split across the
+       NUMA nodes by a NumaEngine holding one replica of the network per node.
+       The network must not be modified while the server is alive. */
+    class InferenceServer
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        struct Config
+        {
+            uint16_t port = 5005;
+            size_t maxBatchSize = 64;
+            std::chrono::microseconds maxLatency = std::chrono::microseconds(2000);
+        };
+
+        struct Stats
+        {
+            size_t countRequests = 0;
+            size_t countBatches = 0;
+            double averageBatchSize = 0;
+            double averageQueueLatency = 0;  /* seconds */
+            double maxQueueLatency = 0;      /* seconds */
+            double throughput = 0;           /* requests per second since start */
+            size_t countNodes = 0;
+            size_t countWorkers = 0;
+            NumaEngine::Counters engine;
+        };
+
+    public:
+        InferenceServer(NeuralNetwork& nn, Config config);
+        InferenceServer(const InferenceServer&) = delete;
+        InferenceServer& operator=(const InferenceServer&) = delete;
+        ~InferenceServer();
+        /* Blocks serving connections until stop is called, false if the socket could not be set up */
+        bool run();
+        void stop();
+        /* Goes through the same batching queue as socket requests */
+        std::vector<double> classify(std::vector<double> input);
+        Stats getStats() const;
+
+    protected:
+        struct Request
+        {
+            std::vector<double> input;
+            std::promise<std::vector<double>> output;
+            Clock::time_point arrival;
+        };
+
+        void p_batchLoop();
+        void p_processBatch(std::vector<Request>& batch);
+        void p_serveClient(uintptr_t client);
+        void p_joinFinishedClients();
+        static bool p_sendAll(uintptr_t client, const std::string& data);
+        std::string p_handleLine(const std::string& line);
+        static std::string p_formatVector(const std::vector<double>& vector);
+        static std::string p_formatStats(const Stats& stats);
+
+    private:
+        NeuralNetwork& nn;
+        Config config;
+        NumaEngine engine;
+
+        std::deque<Request> queue;
+        std::mutex queueMutex;
+        std::condition_variable queueCv;
+        bool isStopping = false;
+        std::thread batchThread;
+
+        std::atomic<bool> isRunning{ false };
+        uintptr_t listenSocket;
+        std::mutex clientsMutex;
+        std::vector<uintptr_t> clientSockets;
+        std::vector<std::thread> clientThreads;
+        /* Client threads that returned, joined by the accept loop */
+        std::vector<std::thread::id> finishedClients;
+
+        mutable std::mutex statsMutex;
+        Clock::time_point startTime;
+        size_t countRequests = 0;
+        size_t countBatches = 0;
+        double totalQueueLatency = 0;
+        double maxQueueLatency = 0;
+    };
+}
\ No newline at end of file
@@ -3,8 +3,16 @@
 #include <fstream>
 #include <string>
 #include <sstream>
+#include <functional>
+#include <cwctype>
 #include <Awincs.h>
 #include "NeuralNetwork.h"
+#include "TrainingPipeline.h"
+#include "InferenceServer.h"
+#include "SweepRunner.h"
+#include "NumaEngine.h"
+#include "PipelinedNetwork.h"
+#include "SparseNetwork.h"
 
 using InputRef = std::shared_ptr<Awincs::InputComponent>;
 using ButtonRef = std::shared_ptr<Awincs::ButtonComponent>;
@@ -44,6 +52,9 @@ const wchar_t* TRAIN_NN_PANEL_TITLE_BAR = L"Nueral Network - Train";
 
 NN::NeuralNetwork nn;
 
+/* --numa-training trains from the window with NumaEngine mini-batches instead of per-sample steps */
+bool isNumaTraining = false;
+
 
 /*********************************************************/
 /*                      UIParse                          */
@@ -59,11 +70,10 @@ void setupNeuralNetwork(std::vector<int> newLayers, bool force = false)
         for (const auto& layer : layers)
             nn.pushLayer(layer);
 
-        const double maxLim = 1;
-        const double minLim = -1;
+        /* Fixed seed keeps trainings of the same topology reproducible */
+        const uint64_t weightsSeed = 0x5EED;
 
-        for (size_t i = 0; i < layers.size() - 1; i++)
-            nn.setupWeights(i, i + 1, NN::NeuralNetwork::randomizeWeights(minLim, maxLim, layers[i], layers[i + 1]));
+        nn.initializeWeights(weightsSeed, NN::NeuralNetwork::WeightsInitialization::XAVIER);
     }
 }
 
@@ -178,37 +188,51 @@ auto onBackClick = [](const Awincs::Component::Point& p)
 /*********************************************************/
 /*              Particular Panel Load & Save             */
 
-auto onLoadNNDataClick = [](const Awincs::Component::Point& p)
+bool readNeuralNetwork(const std::wstring& filename, const std::function<void()>& onLayerRead = {})
 {
-    std::wstring filename = inputs.loadNeuralNetwork->getText();
     std::ifstream ifs(filename, std::ios_base::binary);
 
     if (!ifs)
-    {
-        MessageBox(NULL, L"Failed to open neural network file", L"Neural network open failed!", MB_OK | MB_ICONWARNING);
-        return;
-    }
+        return false;
 
     nn.clear();
 
     size_t lCount = 0;
     ifs.read(reinterpret_cast<char*>(&lCount), sizeof(lCount));
 
+    if (!ifs || lCount < 2)
+        return false;
+
     for (size_t i = 0; i < lCount; i++)
     {
         int countNeurons = 0;
         ifs.read(reinterpret_cast<char*>(&countNeurons), sizeof(countNeurons));
+
+        if (!ifs || countNeurons <= 0)
+        {
+            nn.clear();
+            return false;
+        }
+
         nn.pushLayer(countNeurons);
     }
 
-    inputs.statusBar->setText(L"Reading neural network from \""s + filename + L"\"..."s);
-    inputs.statusBar->redraw();
-
     for (size_t i = 0; i < lCount - 1; i++)
     {
         size_t countWeights = 0;
         ifs.read(reinterpret_cast<char*>(&countWeights), sizeof(countWeights));
 
+        /* Layer block is weights followed by biases, files without biases get zero biases */
+        const auto& layers = nn.getLayers();
+        const size_t countLayerWeights = static_cast<size_t>(layers[i]) * layers[i + 1];
+
+        /* Any other size is a malformed file, setupWeights would copy past the layer */
+        if (!ifs || (countWeights != countLayerWeights && countWeights != countLayerWeights + layers[i + 1]))
+        {
+            nn.clear();
+            return false;
+        }
+
         std::vector<double> vWeight;
         for (size_t j = 0; j < countWeights; j++)
         {
@@ -217,11 +241,41 @@ auto onLoadNNDataClick = [](const Awincs::Component::Point& p)
             vWeight.emplace_back(weight);
         }
 
-        nn.setupWeights(i ,i + 1, vWeight);
-        panels.window->processMessages();
+        if (!ifs)
+        {
+            nn.clear();
+            return false;
+        }
+
+        std::vector<double> vBias;
+        if (vWeight.size() > countLayerWeights)
+        {
+            vBias.assign(vWeight.begin() + countLayerWeights, vWeight.end());
+            vWeight.resize(countLayerWeights);
+        }
+
+        nn.setupWeights(i ,i + 1, vWeight, vBias);
+
+        if (onLayerRead)
+            onLayerRead();
     }
 
     ifs.close();
+    return true;
+}
+
+auto onLoadNNDataClick = [](const Awincs::Component::Point& p)
+{
+    std::wstring filename = inputs.loadNeuralNetwork->getText();
+
+    inputs.statusBar->setText(L"Reading neural network from \""s + filename + L"\"..."s);
+    inputs.statusBar->redraw();
+
+    if (!readNeuralNetwork(filename, [] { panels.window->processMessages(); }))
+    {
+        MessageBox(NULL, L"Failed to open neural network file", L"Neural network open failed!", MB_OK | MB_ICONWARNING);
+        return;
+    }
 
     inputs.statusBar->setText(L"Reading is completed!"s);
     inputs.statusBar->redraw();
@@ -279,26 +333,14 @@ auto onSaveNNDataClick = [](const Awincs::Component::Point& p)
     inputs.statusBar->redraw();
 };
 
-auto onLoadTrainingDataClick = [](const Awincs::Component::Point& p)
+NN::Dataset::TrainingSet readTrainingSet(const std::wstring& filename, const std::vector<int>& layers, const std::function<void()>& onLineRead = {})
 {
-    if (!inputs.loadTrainingData)
-        return;
-
-    if (!inputs.layers)
-        return;
-
-    std::wstring filename = inputs.loadTrainingData->getText();
     std::wifstream ifs(filename);
 
-    if (!ifs)
-        MessageBox(NULL, L"Failed to open training data file", L"Traing data open failed!", MB_OK | MB_ICONWARNING);
-
-    const auto layers = parseVectorFromString<int>(inputs.layers->getText());
     const int countInputNeurons = layers.front();
     const int countOutputNeurons = layers.back();
 
-    /* Reading training set */
-    std::vector<std::pair<std::vector<double>, std::vector<double>>> trainingSet;
+    NN::Dataset::TrainingSet trainingSet;
     std::wstring line;
     int lineNumber = 1;
     while (std::getline(ifs, line))
@@ -317,28 +359,137 @@ auto onLoadTrainingDataClick = [](const Awincs::Component::Point& p)
                 << countInputNeurons << L". File: " << filename << L"; Line: " << lineNumber << L"\n");
 
         trainingSet.push_back({ vec, cls });
-        panels.window->processMessages();
+
+        if (onLineRead)
+            onLineRead();
+
         lineNumber++;
     }
     ifs.close();
 
+    return trainingSet;
+}
+
+/* Placement and cross-node traffic of the engine for the status bar */
+std::wstring formatEngineCounters(const NN::NumaEngine& engine)
+{
+    auto counters = engine.getCounters();
+
+    return L" ("s + std::to_wstring(engine.getCountNodes()) + L" nodes, "s
+        + std::to_wstring(engine.getCountWorkers() - counters.countUnpinnedWorkers) + L"/"s
+        + std::to_wstring(engine.getCountWorkers()) + L" workers pinned, cross-node KiB: reduce "s
+        + std::to_wstring(counters.crossNodeReductionBytes / 1024) + L", sync "s
+        + std::to_wstring(counters.crossNodeSyncBytes / 1024) + L")"s;
+}
+
+auto onLoadTrainingDataClick = [](const Awincs::Component::Point& p)
+{
+    if (!inputs.loadTrainingData)
+        return;
+
+    if (!inputs.layers)
+        return;
+
+    std::wstring filename = inputs.loadTrainingData->getText();
+
+    if (!std::wifstream(filename))
+        MessageBox(NULL, L"Failed to open training data file", L"Traing data open failed!", MB_OK | MB_ICONWARNING);
+
+    const auto layers = parseVectorFromString<int>(inputs.layers->getText());
+
+    /* Reading training set */
+    auto trainingSet = readTrainingSet(filename, layers, [] { panels.window->processMessages(); });
+
+    if (trainingSet.empty())
+    {
+        inputs.statusBar->setText(L"Training data is empty!");
+        inputs.statusBar->redraw();
+        return;
+    }
+
+    /* Rows that do not fit the layers would be read past their end */
+    for (const auto& row : trainingSet)
+    {
+        if (row.first.size() != static_cast<size_t>(layers.front()) || row.second.size() != static_cast<size_t>(layers.back()))
+        {
+            inputs.statusBar->setText(L"Training data does not match the layers!");
+            inputs.statusBar->redraw();
+            return;
+        }
+    }
+
     /* Setupping Neural Network */
     setupNeuralNetwork(layers, true);
 
+    /* Both trainers read the contiguous copy, the rows are released so the data is held once */
+    auto dataset = NN::Dataset::create(trainingSet);
+    NN::Dataset::TrainingSet().swap(trainingSet);
+
     /* Trainning */
     const int countIterations = 10000;
 
+    const uint64_t shuffleSeed = 0x5EED;
+
+    /* A lean step trains one sample at a time, per-worker update buffers would defeat its memory plan */
+    if (isNumaTraining && !nn.isLeanTraining())
+    {
+        /* Workers on every NUMA node train on their node-local shard against a node-local replica. Every
+           step applies the mean update of batchSize rows per worker, so an epoch makes far fewer updates
+           than per-sample training and the learning factor needs tuning for it */
+        NN::NumaEngine::Options options;
+        options.seed = shuffleSeed;
+
+        NN::NumaEngine engine(nn, dataset, options);
+
+        for (int i = 0; i < countIterations; i++)
+        {
+            engine.trainEpoch(i);
+            panels.window->processMessages();
+
+            if (i % 10)
+            {
+                inputs.statusBar->setText(L"Training iteration: "s + std::to_wstring(i) + formatEngineCounters(engine));
+                inputs.statusBar->redraw();
+            }
+        }
+
+        inputs.statusBar->setText(L"Training completed!"s + formatEngineCounters(engine));
+        inputs.statusBar->redraw();
+        return;
+    }
+
+    /* Memory of a lean train step is known before it runs */
+    std::wstring memoryText;
+    if (nn.isLeanTraining())
+    {
+        auto plan = nn.getMemoryPlan();
+        memoryText = L" (peak "s + std::to_wstring(plan.getPeakBytes() / 1024) + L" KiB, "s
+            + std::to_wstring(plan.standardPeakBytes / 1024) + L" KiB without lean training)"s;
+
+        inputs.statusBar->setText(L"Training memory:"s + memoryText);
+        inputs.statusBar->redraw();
+    }
+
+    const size_t batchSize = 64;
+
+    NN::TrainingPipeline pipeline(dataset, batchSize, shuffleSeed);
+
     for (int i = 0; i < countIterations; i++)
     {
-        for (const auto& ts : trainingSet)
+        pipeline.beginEpoch(i);
+
+        NN::TrainingPipeline::Batch batch;
+        while (pipeline.nextBatch(batch))
         {
+            for (size_t j = 0; j < batch.count; j++)
+                nn.train(batch.getInput(j), batch.getAnswer(j));
+
             panels.window->processMessages();
-            nn.train(ts.first, ts.second);
         }
 
         if (i % 10)
         {
-            inputs.statusBar->setText(L"Training iteration: "s + std::to_wstring(i));
+            inputs.statusBar->setText(L"Training iteration: "s + std::to_wstring(i) + memoryText);
             inputs.statusBar->redraw();
         }
     }
@@ -387,6 +538,282 @@ auto onClassifyClick = [](const Awincs::Component::Point& p)
 /*********************************************************/
 
 
+/*********************************************************/
+/*           Headless serve, sweep & benchmark           */
+
+/* --serve <model file> [port] [max batch size] [max batch latency, us] */
+bool serveNeuralNetwork(const std::vector<std::wstring>& args)
+{
+    if (args.empty() || !readNeuralNetwork(args[0]))
+        return false;
+
+    NN::InferenceServer::Config config;
+    long long port = config.port;
+    long long maxBatchSize = static_cast<long long>(config.maxBatchSize);
+    long long maxLatency = config.maxLatency.count();
+
+    try
+    {
+        if (args.size() > 1)
+            port = std::stoll(args[1]);
+        if (args.size() > 2)
+            maxBatchSize = std::stoll(args[2]);
+        if (args.size() > 3)
+            maxLatency = std::stoll(args[3]);
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+
+    /* Checked here, the server only asserts them */
+    if (port <= 0 || port > 65535 || maxBatchSize <= 0 || maxLatency < 0)
+        return false;
+
+    config.port = static_cast<uint16_t>(port);
+    config.maxBatchSize = static_cast<size_t>(maxBatchSize);
+    config.maxLatency = std::chrono::microseconds(maxLatency);
+
+    NN::InferenceServer server(nn, config);
+    return server.run();
+}
+
+/* --sweep <training data file> <configurations file> <results file> [epochs] [rung epochs]
+   Every configurations line is "<layers> <learning factor> [seed]", e.g. "2,8,2 0.5 1" */
+bool sweepNeuralNetworks(const std::vector<std::wstring>& args)
+{
+    if (args.size() < 3)
+        return false;
+
+    std::wifstream configurationsFile(args[1]);
+    if (!configurationsFile)
+        return false;
+
+    std::vector<NN::SweepRunner::Configuration> configurations;
+    std::wstring line;
+    while (std::getline(configurationsFile, line))
+    {
+        std::wstringstream ss(line);
+        std::wstring layers;
+        NN::SweepRunner::Configuration configuration;
+
+        if (!(ss >> layers >> configuration.learningFactor))
+            continue;
+
+        try
+        {
+            configuration.layers = parseVectorFromString<int>(layers);
+        }
+        catch (const std::exception&)
+        {
+            DCONSOLE(L"Skipping configuration with malformed layers: " << line << L"\n");
+            continue;
+        }
+
+        ss >> configuration.seed;
+        configurations.push_back(configuration);
+    }
+
+    if (configurations.empty())
+        return false;
+
+    /* Loaded and parsed once, every configuration trains on the same read-only copy */
+    auto trainingSet = readTrainingSet(args[0], configurations.front().layers);
+    if (trainingSet.empty())
+        return false;
+
+    const size_t inputSize = trainingSet.front().first.size();
+    const size_t answerSize = trainingSet.front().second.size();
+
+    for (const auto& row : trainingSet)
+        if (row.first.size() != inputSize || row.second.size() != answerSize)
+            return false;
+
+    /* Checked here, the runner only asserts them */
+    auto isValid = [&](const NN::SweepRunner::Configuration& configuration)
+    {
+        const auto& layers = configuration.layers;
+
+        return layers.size() > 1
+            && std::all_of(layers.begin(), layers.end(), [](int layer) { return layer > 0; })
+            && static_cast<size_t>(layers.front()) == inputSize
+            && static_cast<size_t>(layers.back()) == answerSize
+            && configuration.learningFactor > 0
+            && configuration.learningFactor <= 1;
+    };
+
+    auto invalid = std::stable_partition(configurations.begin(), configurations.end(), isValid);
+    if (invalid != configurations.end())
+        DCONSOLE(L"Skipping " << configurations.end() - invalid << L" configurations that do not fit "
+            << inputSize << L" inputs, " << answerSize << L" outputs or a learning factor in (0, 1]\n");
+
+    configurations.erase(invalid, configurations.end());
+    if (configurations.empty())
+        return false;
+
+    NN::SweepRunner::Options options;
+
+    if (args.size() > 3)
+        options.countEpochs = std::stoul(args[3]);
+    if (args.size() > 4)
+        options.countRungEpochs = std::stoul(args[4]);
+
+    NN::SweepRunner runner(NN::Dataset::create(trainingSet), options);
+    auto results = runner.run(configurations);
+
+    std::wofstream resultsFile(args[2]);
+    resultsFile << NN::SweepRunner::formatResults(results);
+
+    return static_cast<bool>(resultsFile);
+}
+
+/* --pipeline-benchmark <model file> <training data file> <results file> [stages] [micro batch size] [repeats]
+   Classifies the training inputs with the batched and the layer-pipelined path and writes both timings */
+bool benchmarkPipelinedNetwork(const std::vector<std::wstring>& args)
+{
+    if (args.size() < 3 || !readNeuralNetwork(args[0]))
+        return false;
+
+    auto trainingSet = readTrainingSet(args[1], nn.getLayers());
+    if (trainingSet.empty())
+        return false;
+
+    /* Inputs are flattened, a short row would shift every row after it past the end */
+    std::vector<double> inputs;
+    for (const auto& row : trainingSet)
+    {
+        if (row.first.size() != static_cast<size_t>(nn.getLayers().front()))
+            return false;
+
+        inputs.insert(inputs.end(), row.first.begin(), row.first.end());
+    }
+
+    size_t countStages = 0;
+    size_t microBatchSize = 16;
+    size_t countRepeats = 10;
+
+    try
+    {
+        if (args.size() > 3)
+            countStages = std::stoul(args[3]);
+        if (args.size() > 4)
+            microBatchSize = std::stoul(args[4]);
+        if (args.size() > 5)
+            countRepeats = std::stoul(args[5]);
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+
+    /* Checked here, the pipeline only asserts them */
+    if (microBatchSize == 0 || countRepeats == 0)
+        return false;
+
+    NN::PipelinedNetwork pipelined(nn, countStages, microBatchSize);
+    auto result = pipelined.benchmark(nn, inputs.data(), trainingSet.size(), countRepeats);
+
+    std::wofstream resultsFile(args[2]);
+    resultsFile << L"stages " << pipelined.getCountStages() << L" (first layers";
+    for (auto layer : pipelined.getStageLayers())
+        resultsFile << L" " << layer;
+    resultsFile << L")\n"
+        << L"rows " << trainingSet.size() << L", micro batch " << microBatchSize << L", repeats " << countRepeats << L"\n"
+        << L"batched " << result.batchedSeconds << L" s\n"
+        << L"pipelined " << result.pipelinedSeconds << L" s\n"
+        << L"speedup " << result.getSpeedup() << L"\n"
+        << L"max difference " << result.maxDifference << L"\n";
+
+    return static_cast<bool>(resultsFile);
+}
+
+/* --prune <model file> <training data file> <results file> [sparsity] [block density threshold] [fine-tuning epochs]
+   Prunes whole sparse engine blocks of the model, optionally retrains the remaining weights on the
+   training data and compares the sparse inference engine with the dense classify path */
+bool pruneNeuralNetwork(const std::vector<std::wstring>& args)
+{
+    if (args.size() < 3 || !readNeuralNetwork(args[0]))
+        return false;
+
+    const auto layers = nn.getLayers();
+    auto trainingSet = readTrainingSet(args[1], layers);
+    if (trainingSet.empty())
+        return false;
+
+    /* Rows that do not fit the layers would be read past their end */
+    for (const auto& row : trainingSet)
+        if (row.first.size() != static_cast<size_t>(layers.front()) || row.second.size() != static_cast<size_t>(layers.back()))
+            return false;
+
+    double sparsity = 0.9;
+    double densityThreshold = NN::SparseNetwork::DEFAULT_DENSITY_THRESHOLD;
+    size_t countEpochs = 0;
+
+    try
+    {
+        if (args.size() > 3)
+            sparsity = std::stod(args[3]);
+        if (args.size() > 4)
+            densityThreshold = std::stod(args[4]);
+        if (args.size() > 5)
+            countEpochs = std::stoul(args[5]);
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+
+    if (sparsity < 0 || sparsity >= 1 || densityThreshold < 0 || densityThreshold > 1)
+        return false;
+
+    std::vector<std::vector<double>> samples;
+    for (const auto& row : trainingSet)
+        samples.push_back(row.first);
+
+    /* Pruning single weights would leave almost every block of the sparse engine non-empty */
+    nn.prune(sparsity, NN::SparseNetwork::BLOCK_ROWS, NN::SparseNetwork::BLOCK_COLS);
+
+    /* Pruned weights stay zero while the others recover the accuracy */
+    const uint64_t shuffleSeed = 0x5EED;
+    double loss = 0;
+
+    for (size_t epoch = 0; epoch < countEpochs; epoch++)
+    {
+        loss = 0;
+
+        for (auto index : NN::NeuralNetwork::shuffleIndices(trainingSet.size(), shuffleSeed, static_cast<uint32_t>(epoch)))
+            loss += nn.train(trainingSet[index].first, trainingSet[index].second);
+
+        loss /= trainingSet.size();
+    }
+
+    NN::SparseNetwork sparse(nn, densityThreshold);
+    auto report = sparse.compare(nn, samples);
+
+    std::wofstream resultsFile(args[2]);
+    resultsFile << L"sparsity " << sparsity << L", sparse layers " << report.countSparseLayers
+        << L" of " << sparse.getCountLayers() << L"\n";
+
+    if (countEpochs > 0)
+        resultsFile << L"fine-tuning epochs " << countEpochs << L", last epoch loss " << loss << L"\n";
+
+    for (size_t i = 0; i < sparse.getCountLayers(); i++)
+        resultsFile << L"layer " << i << L": density " << sparse.getLayerDensity(i)
+            << L", block density " << sparse.getLayerBlockDensity(i)
+            << (sparse.isLayerSparse(i) ? L", sparse\n" : L", dense\n");
+
+    resultsFile << L"dense " << report.denseBytes << L" bytes, " << report.denseLatency * 1e6 << L" us per sample\n"
+        << L"sparse " << report.sparseBytes << L" bytes, " << report.sparseLatency * 1e6 << L" us per sample\n"
+        << L"size reduction " << report.getSizeReduction() << L"x\n"
+        << L"latency reduction " << report.getLatencyReduction() << L"x\n";
+
+    return static_cast<bool>(resultsFile);
+}
+
+/*********************************************************/
+/*********************************************************/
+
+
 /*********************************************************/
 /*                      UISetup                          */
 
@@ -596,6 +1023,60 @@ void mountPanels(const ComponentRef& cmp, Awincs::Component::Dimensions d)
 
 Awincs::AppRetType Awincs::App(std::vector<std::wstring> args)
 {
+    auto serveArg = std::find(args.begin(), args.end(), L"--serve");
+    if (serveArg != args.end())
+    {
+        if (!serveNeuralNetwork(std::vector<std::wstring>(serveArg + 1, args.end())))
+            MessageBox(NULL, L"Failed to start neural network server", L"Neural network server failed!", MB_OK | MB_ICONWARNING);
+
+        return {};
+    }
+
+    auto sweepArg = std::find(args.begin(), args.end(), L"--sweep");
+    if (sweepArg != args.end())
+    {
+        if (!sweepNeuralNetworks(std::vector<std::wstring>(sweepArg + 1, args.end())))
+            MessageBox(NULL, L"Failed to run neural network sweep", L"Neural network sweep failed!", MB_OK | MB_ICONWARNING);
+
+        return {};
+    }
+
+    auto pruneArg = std::find(args.begin(), args.end(), L"--prune");
+    if (pruneArg != args.end())
+    {
+        if (!pruneNeuralNetwork(std::vector<std::wstring>(pruneArg + 1, args.end())))
+            MessageBox(NULL, L"Failed to prune neural network", L"Neural network pruning failed!", MB_OK | MB_ICONWARNING);
+
+        return {};
+    }
+
+    auto benchmarkArg = std::find(args.begin(), args.end(), L"--pipeline-benchmark");
+    if (benchmarkArg != args.end())
+    {
+        if (!benchmarkPipelinedNetwork(std::vector<std::wstring>(benchmarkArg + 1, args.end())))
+            MessageBox(NULL, L"Failed to run pipelined inference benchmark", L"Neural network benchmark failed!", MB_OK | MB_ICONWARNING);
+
+        return {};
+    }
+
+    if (std::find(args.begin(), args.end(), L"--numa-training") != args.end())
+        isNumaTraining = true;
+
+    /* --deterministic makes training bit-reproducible for A/B comparisons */
+    if (std::find(args.begin(), args.end(), L"--deterministic") != args.end())
+        nn.setDeterministic(true);
+
+    /* --lean-training [checkpoint interval] trains on a fixed memory plan */
+    auto leanArg = std::find(args.begin(), args.end(), L"--lean-training");
+    if (leanArg != args.end())
+    {
+        size_t checkpointInterval = 0;
+        if (leanArg + 1 != args.end() && !leanArg[1].empty() && std::iswdigit(leanArg[1][0]))
+            checkpointInterval = std::stoul(leanArg[1]);
+
+        nn.setLeanTraining(true, checkpointInterval);
+    }
+
     auto wnd = std::make_shared<WindowController>();
     wnd->setDimensions({ 360, 300 });
     wnd->setMinDimensions({360, 300});
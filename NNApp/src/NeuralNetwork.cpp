@@ -1,15 +1,22 @@
 #include "pch.h"
 #include "NeuralNetwork.h"
+#include "Philox.h"
 
 
 #include <numeric>
 #include <execution>
 #include <random>
+#include <algorithm>
+#include <cmath>
 #include <cassert>
 #define expect(x) assert(x)
 
 namespace NN
 {
+    size_t NeuralNetwork::MemoryPlan::getPeakBytes() const
+    {
+        return parameterBytes + activationBytes + scratchBytes;
+    }
     const std::vector<int>& NeuralNetwork::getLayers() const
     {
         return layers;
@@ -21,9 +28,20 @@ namespace NN
         expect(layerB - layerA == 1);
         expect(layerB < layers.size());
 
-        auto ilWeights = weights.at(layerA);
+        const auto& ilWeights = weights.at(layerA);
 
-        return std::vector<double>(std::begin(ilWeights), std::end(ilWeights));
+        return std::vector<double>(std::begin(ilWeights), std::begin(ilWeights) + p_countWeights(layerA));
+    }
+    std::vector<double> NeuralNetwork::getBiases(size_t layerA, size_t layerB) const
+    {
+        expect(layerA >= 0);
+        expect(layerB >= 0);
+        expect(layerB - layerA == 1);
+        expect(layerB < layers.size());
+
+        const auto& ilWeights = weights.at(layerA);
+
+        return std::vector<double>(std::begin(ilWeights) + p_countWeights(layerA), std::end(ilWeights));
     }
     void NeuralNetwork::pushLayer(int countNeurons)
     {
@@ -31,8 +49,10 @@ namespace NN
 
         if (layers.size() > 1)
             weights.emplace_back();
+
+        leanBuffer.clear();
     }
-    void NeuralNetwork::setupWeights(size_t layerA, size_t layerB, std::vector<double> weights)
+    void NeuralNetwork::setupWeights(size_t layerA, size_t layerB, std::vector<double> weights, std::vector<double> biases)
     {
         expect(layerA >= 0);
         expect(layerB >= 0);
@@ -41,42 +61,233 @@ namespace NN
         expect(weights.size() > 0);
         expect(this->weights.size() >= layerA);
         expect(layers[layerA] * layers[layerB] == weights.size());
+        expect(biases.empty() || biases.size() == layers[layerB]);
+
+        /* Biases live right after the weights of the same layer, zero unless given */
+        vel parameters(0.0, weights.size() + layers[layerB]);
+        std::copy(weights.begin(), weights.end(), std::begin(parameters));
+        std::copy(biases.begin(), biases.end(), std::begin(parameters) + weights.size());
 
-        this->weights[layerA] = vel(weights.data(), weights.size());
+        /* The replaced layer is no longer pruned, the other layers keep their masks */
+        if (isPruned())
+            pruningMasks[layerA] = vel(1.0, parameters.size());
+
+        this->weights[layerA] = std::move(parameters);
+    }
+    void NeuralNetwork::initializeWeights(uint64_t seed, WeightsInitialization scheme)
+    {
+        expect(layers.size() > 1);
+        expect(weights.size() == layers.size() - 1);
+
+        for (size_t i = 0; i < weights.size(); i++)
+        {
+            const double fanIn = layers[i];
+            const double fanOut = layers[i + 1];
+            double limit = 1;
+
+            if (scheme == WeightsInitialization::XAVIER)
+                limit = std::sqrt(6 / (fanIn + fanOut));
+            else if (scheme == WeightsInitialization::HE)
+                limit = std::sqrt(6 / fanIn);
+
+            /* Biases start at zero, every layer draws from its own Philox stream */
+            weights[i] = vel(0.0, p_countWeights(i) + layers[i + 1]);
+            p_fillUniform(std::begin(weights[i]), p_countWeights(i), -limit, limit, seed, static_cast<uint32_t>(i));
+        }
+
+        pruningMasks.clear();
     }
     double NeuralNetwork::train(std::vector<double> input, std::vector<double> ans)
     {
         expect(input.size() > 0);
-        expect(layers.size() > 1);
         expect(input.size() == layers[0]);
         expect(layers.back() == ans.size());
 
+        return train(input.data(), ans.data());
+    }
+    double NeuralNetwork::train(const double* input, const double* ans)
+    {
+        expect(input != nullptr);
+        expect(ans != nullptr);
+        expect(layers.size() > 1);
+
+        if (leanTraining)
+            return p_trainLean(input, ans);
+
         auto outputs = p_classify(input);
         
-        vel answer(ans.data(), ans.size());
+        vel answer(ans, layers.back());
         vel error = answer - outputs.back();
 
         p_backPropagation(lFactor, outputs, error);
 
+        /* Fine-tuning a pruned network must keep pruned weights at zero */
+        if (isPruned())
+            p_applyPruningMasks();
+
         error = std::pow(error, 2);
-        return std::reduce(std::begin(error), std::end(error)) / ans.size();
+        return std::accumulate(std::begin(error), std::end(error), 0.0) / layers.back();
     }
     std::vector<double> NeuralNetwork::classify(std::vector<double> input)
     {
-        auto output = p_classify(input).back();
+        expect(input.size() == layers[0]);
+
+        auto output = p_classify(input.data()).back();
         return std::vector<double>(std::begin(output), std::end(output));
     }
+    std::vector<double> NeuralNetwork::classifyBatch(const double* inputs, size_t count, bool isParallel)
+    {
+        expect(inputs != nullptr);
+        expect(layers.size() > 1);
+        expect(weights.size() == layers.size() - 1);
+
+        std::vector<double> current(inputs, inputs + count * layers[0]);
+
+        for (size_t i = 0; i < weights.size(); i++)
+        {
+            const int countInputs = layers[i];
+            const int countOutputs = layers[i + 1];
+            const double* layerWeights = std::begin(weights[i]);
+            const double* layerBiases = layerWeights + p_countWeights(i);
+
+            std::vector<double> next(count * countOutputs);
+            std::vector<int> neurons(countOutputs);
+            std::iota(neurons.begin(), neurons.end(), 0);
+
+            /* Each weight row stays hot in cache while it is applied to the whole batch */
+            auto calcNeuron = [&](int j)
+            {
+                const double* row = layerWeights + static_cast<size_t>(j) * countInputs;
+
+                for (size_t s = 0; s < count; s++)
+                {
+                    double value = p_blockedDotProduct(row, current.data() + s * countInputs, countInputs, layerBiases[j]);
+                    next[s * countOutputs + j] = p_applyActivationFunction(value);
+                }
+            };
+
+            if (isParallel)
+                std::for_each(std::execution::par, neurons.begin(), neurons.end(), calcNeuron);
+            else
+                std::for_each(neurons.begin(), neurons.end(), calcNeuron);
+
+            current = std::move(next);
+        }
+
+        return current;
+    }
+    double NeuralNetwork::accumulateUpdates(const double* input, const double* ans, std::vector<std::valarray<double>>& updates, bool isParallel)
+    {
+        expect(input != nullptr);
+        expect(ans != nullptr);
+        expect(layers.size() > 1);
+
+        if (updates.size() != weights.size())
+        {
+            updates.resize(weights.size());
+            for (size_t i = 0; i < weights.size(); i++)
+                updates[i].resize(weights[i].size());
+        }
+
+        auto outputs = p_classify(input, isParallel);
+
+        vel answer(ans, layers.back());
+        vel error = answer - outputs.back();
+
+        /* Same rule as p_backPropagation, but deltas see the weights before the update */
+        vel prevDeltas = p_calcOutputDeltas(outputs.back(), error);
+        for (size_t i = layers.size() - 2; i > 0; i--)
+        {
+            const size_t countWeights = p_countWeights(i);
+
+            updates[i][std::slice(0, countWeights, 1)] += p_calcGradientW(outputs[i], prevDeltas);
+            updates[i][std::slice(countWeights, layers[i + 1], 1)] += prevDeltas;
+
+            prevDeltas = p_calcDefaultDeltas(outputs[i], weights[i][std::slice(0, countWeights, 1)], prevDeltas, isParallel);
+        }
+
+        error = std::pow(error, 2);
+        return std::accumulate(std::begin(error), std::end(error), 0.0) / layers.back();
+    }
+    void NeuralNetwork::applyUpdates(const std::vector<std::valarray<double>>& updates, double scale)
+    {
+        expect(updates.size() == weights.size());
+
+        for (size_t i = 0; i < weights.size(); i++)
+        {
+            expect(updates[i].size() == weights[i].size());
+            weights[i] += updates[i] * (lFactor * scale);
+        }
+
+        if (isPruned())
+            p_applyPruningMasks();
+    }
     void NeuralNetwork::setLearningFactor(double factor)
     {
         expect(factor > 0);
         expect(factor <= 1);
         lFactor = factor;
     }
+    void NeuralNetwork::setDeterministic(bool deterministic)
+    {
+        this->deterministic = deterministic;
+    }
+    bool NeuralNetwork::isDeterministic() const
+    {
+        return deterministic;
+    }
+    void NeuralNetwork::setLeanTraining(bool lean, size_t checkpointInterval)
+    {
+        leanTraining = lean;
+        this->checkpointInterval = checkpointInterval;
+        leanBuffer.clear();
+    }
+    bool NeuralNetwork::isLeanTraining() const
+    {
+        return leanTraining;
+    }
+    NeuralNetwork::MemoryPlan NeuralNetwork::getMemoryPlan() const
+    {
+        expect(layers.size() > 1);
+
+        MemoryPlan plan;
+        std::vector<size_t> offsets;
+        const size_t outputLayer = layers.size() - 1;
+        const size_t maxWidth = *std::max_element(layers.begin(), layers.end());
+
+        plan.checkpointInterval = p_getCheckpointInterval();
+        plan.activationBytes = p_layoutActivations(offsets) * sizeof(double);
+        plan.scratchBytes = 2 * maxWidth * sizeof(double) + maxWidth * sizeof(int);
+
+        size_t countParameters = 0;
+        size_t maxCountWeights = 0;
+        for (size_t i = 0; i < outputLayer; i++)
+        {
+            countParameters += p_countWeights(i) + layers[i + 1];
+            maxCountWeights = std::max(maxCountWeights, p_countWeights(i));
+        }
+        plan.parameterBytes = countParameters * sizeof(double);
+
+        /* Backward recomputes every segment below the one left over by the forward pass */
+        const size_t topSegment = p_getTopSegment();
+        for (size_t i = 1; i < outputLayer; i++)
+            if (!p_isCheckpoint(i) && i / plan.checkpointInterval != topSegment)
+                plan.countRecomputedLayers++;
+
+        /* train keeps all activations twice while classifying, and the widest layer holds its
+           gradient, scaled gradient, weights copy and transposed weights at once */
+        const size_t countNeurons = std::accumulate(layers.begin(), layers.end(), size_t(0));
+        plan.standardPeakBytes = (countParameters + 2 * countNeurons + 4 * maxCountWeights) * sizeof(double);
+
+        return plan;
+    }
     void NeuralNetwork::clear()
     {
         isInitialized = false;
         layers.clear();
         weights.clear();
+        pruningMasks.clear();
+        leanBuffer.clear();
     }
     std::vector<std::vector<double>> NeuralNetwork::getWeights()
     {
@@ -87,24 +298,101 @@ namespace NN
 
         return output;
     }
+    void NeuralNetwork::prune(double sparsity, int blockRows, int blockCols)
+    {
+        expect(sparsity >= 0);
+        expect(sparsity < 1);
+        expect(blockRows > 0);
+        expect(blockCols > 0);
+        expect(weights.size() == layers.size() - 1);
+
+        pruningMasks.resize(weights.size());
+
+        for (size_t i = 0; i < weights.size(); i++)
+        {
+            /* Biases are never pruned */
+            const size_t countWeights = p_countWeights(i);
+            const size_t countInputs = layers[i];
+            const size_t countBlockCols = (countInputs + blockCols - 1) / blockCols;
+            const size_t countBlocks = (layers[i + 1] + blockRows - 1) / blockRows * countBlockCols;
+            auto blockOf = [&](size_t k) { return k / countInputs / blockRows * countBlockCols + k % countInputs / blockCols; };
+
+            /* Edge blocks hold fewer weights, so blocks are ranked by their mean square */
+            std::vector<double> norms(countBlocks, 0.0);
+            std::vector<size_t> sizes(countBlocks, 0);
+            for (size_t k = 0; k < countWeights; k++)
+            {
+                norms[blockOf(k)] += weights[i][k] * weights[i][k];
+                sizes[blockOf(k)]++;
+            }
+
+            for (size_t b = 0; b < countBlocks; b++)
+                norms[b] /= sizes[b];
+
+            vel mask(1.0, weights[i].size());
+            size_t countPruned = static_cast<size_t>(sparsity * countBlocks);
+
+            if (countPruned > 0)
+            {
+                std::vector<size_t> order(countBlocks);
+                std::iota(order.begin(), order.end(), 0);
+                std::nth_element(order.begin(), order.begin() + countPruned, order.end(),
+                    [&](size_t a, size_t b) { return norms[a] < norms[b]; });
+
+                std::vector<bool> isBlockPruned(countBlocks, false);
+                for (size_t b = 0; b < countPruned; b++)
+                    isBlockPruned[order[b]] = true;
+
+                for (size_t k = 0; k < countWeights; k++)
+                    if (isBlockPruned[blockOf(k)])
+                        mask[k] = 0;
+            }
+
+            pruningMasks[i] = mask;
+        }
+
+        p_applyPruningMasks();
+    }
+    bool NeuralNetwork::isPruned() const
+    {
+        return !pruningMasks.empty();
+    }
     std::vector<double> NeuralNetwork::randomizeWeights(double lowerLimit, double highterLimit, int countNeuronsLayerA, int countNeuronsLayerB)
     {
         std::random_device rd;
-        std::mt19937 generator(rd());
-        std::uniform_real_distribution<double> dist(lowerLimit, highterLimit);
-
-        std::vector<double> output;
-        output.reserve(countNeuronsLayerA * countNeuronsLayerB);
+        uint64_t seed = (static_cast<uint64_t>(rd()) << 32) | rd();
 
-        for (int i = 0; i < countNeuronsLayerA * countNeuronsLayerB; i++)
-            output.emplace_back(dist(generator));
+        return randomizeWeights(lowerLimit, highterLimit, countNeuronsLayerA, countNeuronsLayerB, seed, 0);
+    }
+    std::vector<double> NeuralNetwork::randomizeWeights(double lowerLimit, double highterLimit, int countNeuronsLayerA, int countNeuronsLayerB, uint64_t seed, uint32_t stream)
+    {
+        std::vector<double> output(static_cast<size_t>(countNeuronsLayerA) * countNeuronsLayerB);
+        p_fillUniform(output.data(), output.size(), lowerLimit, highterLimit, seed, stream);
 
         return output;
     }
-    std::vector<NeuralNetwork::vel> NeuralNetwork::p_classify(std::vector<double> inp)
+    std::vector<size_t> NeuralNetwork::shuffleIndices(size_t count, uint64_t seed, uint32_t epoch)
+    {
+        /* Fisher-Yates driven by Philox, the permutation depends only on seed and epoch */
+        const uint32_t shuffleStream = 0xFFFFFFFF;
+        const Philox philox(seed);
+
+        std::vector<size_t> indices(count);
+        std::iota(indices.begin(), indices.end(), 0);
+
+        for (size_t i = count; i > 1; i--)
+        {
+            auto block = philox((static_cast<uint64_t>(epoch) << 32) | (i - 1), shuffleStream);
+            size_t j = static_cast<size_t>((static_cast<uint64_t>(block[0]) * i) >> 32);
+            std::swap(indices[i - 1], indices[j]);
+        }
+
+        return indices;
+    }
+    std::vector<NeuralNetwork::vel> NeuralNetwork::p_classify(const double* inp, bool isParallel)
     {
         expect(layers.size() > 1);
-        expect(inp.size() == layers[0]);
+        expect(inp != nullptr);
         expect(weights.size() == layers.size() - 1);
 
         std::vector<vel> outputs;
@@ -112,19 +400,46 @@ namespace NN
         for (size_t i = 0; i < layers.size(); i++)
             outputs[i].resize(layers[i]);
 
-        outputs[0] = vel(inp.data(), inp.size());
+        outputs[0] = vel(inp, layers[0]);
 
         for (size_t i = 0; i < weights.size(); i++)
         {
             /* Loop through layers */
             std::vector<double> nextLayerOutput;
 
+            const double* layerWeights = std::begin(weights[i]);
+            const double* layerBiases = layerWeights + p_countWeights(i);
+
+            if (deterministic || !isParallel)
+            {
+                /* Every neuron sums in a fixed order, the neurons run in parallel unless isParallel is false */
+                const double* layerInputs = std::begin(outputs[i]);
+                std::vector<int> neurons(layers[i + 1]);
+                std::iota(neurons.begin(), neurons.end(), 0);
+
+                outputs[i + 1].resize(layers[i + 1]);
+                double* layerOutputs = std::begin(outputs[i + 1]);
+
+                auto calcNeuron = [&](int j)
+                {
+                    double value = p_blockedDotProduct(layerWeights + j * layers[i], layerInputs, layers[i], layerBiases[j]);
+                    layerOutputs[j] = p_applyActivationFunction(value);
+                };
+
+                if (isParallel)
+                    std::for_each(std::execution::par, neurons.begin(), neurons.end(), calcNeuron);
+                else
+                    std::for_each(neurons.begin(), neurons.end(), calcNeuron);
+
+                continue;
+            }
+
             for (int j = 0; j < layers[i + 1]; j++)
             {
-                /* Loop through each neuron on next level */
-                vel nextLayerNeuronWeights = weights[i][std::slice(j * layers[i], layers[i], 1)];
-                nextLayerNeuronWeights *= outputs[i];
-                double nextLayerNeuronInputValue = std::reduce(std::execution::par_unseq, std::begin(nextLayerNeuronWeights), std::end(nextLayerNeuronWeights));
+                /* Loop through each neuron on next level, the bias is the accumulator init */
+                const double* nextLayerNeuronWeights = layerWeights + j * layers[i];
+                double nextLayerNeuronInputValue = std::transform_reduce(std::execution::par_unseq,
+                    nextLayerNeuronWeights, nextLayerNeuronWeights + layers[i], std::begin(outputs[i]), layerBiases[j]);
                 double nextLayerNeuronOutput = p_applyActivationFunction(nextLayerNeuronInputValue);
                 nextLayerOutput.push_back(nextLayerNeuronOutput);
             }
@@ -154,11 +469,14 @@ namespace NN
         vel prevDeltas = p_calcOutputDeltas(outputs.back(), errors);
         for (size_t i = layers.size() - 2; i > 0; i--)
         {
+            const size_t countWeights = p_countWeights(i);
+
             vel gradW = p_calcGradientW(outputs[i], prevDeltas);
             vel deltaW = gradW * learningFactor;
-            this->weights[i] += deltaW;
+            this->weights[i][std::slice(0, countWeights, 1)] += deltaW;
+            this->weights[i][std::slice(countWeights, layers[i + 1], 1)] += prevDeltas * learningFactor;
 
-            vel deltas = p_calcDefaultDeltas(outputs[i], this->weights[i], prevDeltas);
+            vel deltas = p_calcDefaultDeltas(outputs[i], this->weights[i][std::slice(0, countWeights, 1)], prevDeltas);
             prevDeltas = deltas;
         }
     }
@@ -166,7 +484,7 @@ namespace NN
     {
         return errors * p_applyActivationFunctionDerivative(outputs);
     }
-    NeuralNetwork::vel NeuralNetwork::p_calcDefaultDeltas(const vel& outputs, const vel& weights, const vel& deltas)
+    NeuralNetwork::vel NeuralNetwork::p_calcDefaultDeltas(const vel& outputs, const vel& weights, const vel& deltas, bool isParallel)
     {
         auto currentLayerCountNeurons = outputs.size();
         auto nextLayerCountNeurons = weights.size() / outputs.size();
@@ -175,6 +493,24 @@ namespace NN
         vel sums;
         sums.resize(currentLayerCountNeurons);
 
+        if (deterministic || !isParallel)
+        {
+            std::vector<size_t> neurons(currentLayerCountNeurons);
+            std::iota(neurons.begin(), neurons.end(), 0);
+
+            auto calcSum = [&](size_t i)
+            {
+                sums[i] = p_blockedDotProduct(&tw[i * nextLayerCountNeurons], std::begin(deltas), nextLayerCountNeurons, 0);
+            };
+
+            if (isParallel)
+                std::for_each(std::execution::par, neurons.begin(), neurons.end(), calcSum);
+            else
+                std::for_each(neurons.begin(), neurons.end(), calcSum);
+
+            return p_applyActivationFunctionDerivative(outputs) * sums;
+        }
+
         for (size_t i = 0; i < currentLayerCountNeurons; i++)
         {
             auto test = vel(tw[std::slice(i * nextLayerCountNeurons, nextLayerCountNeurons, 1)]);
@@ -210,4 +546,239 @@ namespace NN
 
         return gradW;
     }
+    void NeuralNetwork::p_applyPruningMasks()
+    {
+        expect(pruningMasks.size() == weights.size());
+
+        for (size_t i = 0; i < weights.size(); i++)
+            weights[i] *= pruningMasks[i];
+    }
+    size_t NeuralNetwork::p_countWeights(size_t layer) const
+    {
+        return static_cast<size_t>(layers[layer]) * layers[layer + 1];
+    }
+    double NeuralNetwork::p_trainLean(const double* input, const double* ans)
+    {
+        if (leanBuffer.empty())
+            p_allocateMemoryPlan();
+
+        const size_t outputLayer = layers.size() - 1;
+        const size_t interval = p_getCheckpointInterval();
+        double* activations = leanBuffer.data();
+        auto layerActivations = [&](size_t layer) { return activations + activationOffsets[layer]; };
+
+        std::copy(input, input + layers[0], layerActivations(0));
+        for (size_t i = 0; i < outputLayer; i++)
+            p_forwardLayer(i, layerActivations(i), layerActivations(i + 1));
+
+        /* Same rule as p_backPropagation, deltas ping-pong between two buffers */
+        double* deltas = leanBuffer.data() + deltasOffset;
+        double* prevDeltas = deltas + leanIndices.size();
+        const double* outputs = layerActivations(outputLayer);
+        double loss = 0;
+
+        for (int j = 0; j < layers.back(); j++)
+        {
+            double error = ans[j] - outputs[j];
+            deltas[j] = error * p_applyActivationFunctionDerivative(outputs[j]);
+            loss += std::pow(error, 2);
+        }
+
+        size_t residentSegment = p_getTopSegment();
+
+        for (size_t i = outputLayer - 1; i > 0; i--)
+        {
+            if (!p_isCheckpoint(i) && i / interval != residentSegment)
+            {
+                /* Weights below layer i are not updated yet, so recomputing gives the same values */
+                residentSegment = i / interval;
+                for (size_t l = residentSegment * interval; l < i; l++)
+                    p_forwardLayer(l, layerActivations(l), layerActivations(l + 1));
+            }
+
+            p_updateLayerInPlace(i, layerActivations(i), deltas);
+
+            if (i > 1)
+            {
+                p_backPropagateDeltas(i, layerActivations(i), deltas, prevDeltas);
+                std::swap(deltas, prevDeltas);
+            }
+        }
+
+        if (isPruned())
+            p_applyPruningMasks();
+
+        return loss / layers.back();
+    }
+    void NeuralNetwork::p_allocateMemoryPlan()
+    {
+        expect(layers.size() > 1);
+        expect(weights.size() == layers.size() - 1);
+
+        /* One block for activations and deltas, nothing is allocated per train step */
+        const size_t maxWidth = *std::max_element(layers.begin(), layers.end());
+        deltasOffset = p_layoutActivations(activationOffsets);
+
+        leanBuffer.assign(deltasOffset + 2 * maxWidth, 0.0);
+        leanIndices.resize(maxWidth);
+        std::iota(leanIndices.begin(), leanIndices.end(), 0);
+    }
+    size_t NeuralNetwork::p_layoutActivations(std::vector<size_t>& offsets) const
+    {
+        /* Layers between two checkpoints share k - 1 segment buffers, checkpoints follow them */
+        const size_t interval = p_getCheckpointInterval();
+        size_t segmentWidth = 0;
+
+        for (size_t i = 0; i < layers.size(); i++)
+            if (!p_isCheckpoint(i))
+                segmentWidth = std::max(segmentWidth, static_cast<size_t>(layers[i]));
+
+        size_t size = (interval - 1) * segmentWidth;
+        offsets.resize(layers.size());
+
+        for (size_t i = 0; i < layers.size(); i++)
+        {
+            if (p_isCheckpoint(i))
+            {
+                offsets[i] = size;
+                size += layers[i];
+            }
+            else
+                offsets[i] = (i % interval - 1) * segmentWidth;
+        }
+
+        return size;
+    }
+    size_t NeuralNetwork::p_getCheckpointInterval() const
+    {
+        /* Longer intervals keep the same checkpoints but would plan segment buffers no layer uses */
+        const size_t maxInterval = std::max<size_t>(1, layers.size() - 1);
+
+        if (checkpointInterval > 0)
+            return std::min(checkpointInterval, maxInterval);
+
+        return std::max<size_t>(1, static_cast<size_t>(std::sqrt(static_cast<double>(layers.size()))));
+    }
+    size_t NeuralNetwork::p_getTopSegment() const
+    {
+        /* The forward pass leaves the highest non-checkpoint layers in the segment buffers */
+        size_t layer = layers.size() - 2;
+        while (layer > 0 && p_isCheckpoint(layer))
+            layer--;
+
+        return layer / p_getCheckpointInterval();
+    }
+    bool NeuralNetwork::p_isCheckpoint(size_t layer) const
+    {
+        /* The output layer is always kept, the error is taken from it */
+        return layer % p_getCheckpointInterval() == 0 || layer == layers.size() - 1;
+    }
+    void NeuralNetwork::p_forwardLayer(size_t layer, const double* inputs, double* outputs)
+    {
+        const int countInputs = layers[layer];
+        const double* layerWeights = std::begin(weights[layer]);
+        const double* layerBiases = layerWeights + p_countWeights(layer);
+
+        std::for_each(std::execution::par, leanIndices.begin(), leanIndices.begin() + layers[layer + 1], [&](int j)
+        {
+            double value = p_blockedDotProduct(layerWeights + static_cast<size_t>(j) * countInputs, inputs, countInputs, layerBiases[j]);
+            outputs[j] = p_applyActivationFunction(value);
+        });
+    }
+    void NeuralNetwork::p_updateLayerInPlace(size_t layer, const double* outputs, const double* deltas)
+    {
+        /* Element k gets outputs[k / next] * deltas[k % next], the layout p_calcGradientW produces */
+        const size_t countInputs = layers[layer];
+        const size_t countNext = layers[layer + 1];
+        double* layerWeights = std::begin(weights[layer]);
+        double* layerBiases = layerWeights + p_countWeights(layer);
+
+        std::for_each(std::execution::par, leanIndices.begin(), leanIndices.begin() + countNext, [&](int j)
+        {
+            size_t k = static_cast<size_t>(j) * countInputs;
+            size_t o = k / countNext;
+            size_t d = k % countNext;
+
+            for (size_t end = k + countInputs; k < end; k++)
+            {
+                layerWeights[k] += outputs[o] * deltas[d] * lFactor;
+
+                if (++d == countNext)
+                {
+                    d = 0;
+                    o++;
+                }
+            }
+
+            layerBiases[j] += deltas[j] * lFactor;
+        });
+    }
+    void NeuralNetwork::p_backPropagateDeltas(size_t layer, const double* outputs, const double* deltas, double* prevDeltas)
+    {
+        /* Columns of the row-major weights, no transposed copy */
+        const size_t countInputs = layers[layer];
+        const size_t countNext = layers[layer + 1];
+        const double* layerWeights = std::begin(weights[layer]);
+
+        std::for_each(std::execution::par, leanIndices.begin(), leanIndices.begin() + countInputs, [&](int a)
+        {
+            double sum = p_blockedDotProduct(layerWeights + a, countInputs, deltas, countNext, 0);
+            prevDeltas[a] = p_applyActivationFunctionDerivative(outputs[a]) * sum;
+        });
+    }
+    double NeuralNetwork::p_blockedDotProduct(const double* a, const double* b, size_t count, double init)
+    {
+        /* Four independent lanes vectorize well and are always combined in the same order */
+        double lanes[4] = {};
+        size_t i = 0;
+
+        for (; i + 4 <= count; i += 4)
+            for (size_t k = 0; k < 4; k++)
+                lanes[k] += a[i + k] * b[i + k];
+
+        double tail = 0;
+        for (; i < count; i++)
+            tail += a[i] * b[i];
+
+        return init + ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + tail;
+    }
+    double NeuralNetwork::p_blockedDotProduct(const double* a, size_t strideA, const double* b, size_t count, double init)
+    {
+        /* Same lanes and order as above, a is read with a stride */
+        double lanes[4] = {};
+        size_t i = 0;
+
+        for (; i + 4 <= count; i += 4)
+            for (size_t k = 0; k < 4; k++)
+                lanes[k] += a[(i + k) * strideA] * b[i + k];
+
+        double tail = 0;
+        for (; i < count; i++)
+            tail += a[i * strideA] * b[i];
+
+        return init + ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + tail;
+    }
+    void NeuralNetwork::p_fillUniform(double* data, size_t count, double lowerLimit, double higherLimit, uint64_t seed, uint32_t stream)
+    {
+        /* Element n always comes from counter n / 4, so the result does not depend on the scheduling */
+        const size_t chunkSize = 1 << 14;
+        const Philox philox(seed);
+
+        std::vector<size_t> chunks;
+        for (size_t begin = 0; begin < count; begin += chunkSize)
+            chunks.push_back(begin);
+
+        std::for_each(std::execution::par, chunks.begin(), chunks.end(), [=](size_t begin)
+        {
+            size_t end = std::min(begin + chunkSize, count);
+
+            for (size_t n = begin; n < end; n += 4)
+            {
+                auto block = philox(n / 4, stream);
+
+                for (size_t k = 0; k < 4 && n + k < end; k++)
+                    data[n + k] = lowerLimit + (higherLimit - lowerLimit) * Philox::toUnit(block[k]);
+            }
+        });
+    }
 }
\ No newline at end of file
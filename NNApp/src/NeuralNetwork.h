@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <valarray>
+#include <cstdint>
 
 namespace NN
 {
@@ -10,35 +11,108 @@ namespace NN
     private:
         using vel = std::valarray<double>;
 
+    public:
+        enum class WeightsInitialization
+        {
+            UNIFORM,    /* [-1, 1] */
+            XAVIER,     /* Glorot uniform, suits sigmoid */
+            HE          /* He uniform, suits ReLU */
+        };
+
+        /* Bytes a train step needs, known before the first step */
+        struct MemoryPlan
+        {
+            size_t checkpointInterval = 1;
+            size_t parameterBytes = 0;          /* weights and biases, updated in place */
+            size_t activationBytes = 0;         /* kept checkpoints and one recomputed segment */
+            size_t scratchBytes = 0;            /* ping-pong deltas and neuron indices */
+            size_t countRecomputedLayers = 0;   /* extra forward layers per train step */
+            size_t standardPeakBytes = 0;       /* estimate for a train step without the lean mode */
+
+            size_t getPeakBytes() const;
+        };
+
     public:
         const std::vector<int>& getLayers() const;
         std::vector<double> getWeights(size_t layerA, size_t layerB) const;
+        std::vector<double> getBiases(size_t layerA, size_t layerB) const;
         void pushLayer(int countNeurons);
-        void setupWeights(size_t layerA, size_t layerB, std::vector<double> weights);
+        void setupWeights(size_t layerA, size_t layerB, std::vector<double> weights, std::vector<double> biases = {});
+        void initializeWeights(uint64_t seed, WeightsInitialization scheme = WeightsInitialization::XAVIER);
         double train(std::vector<double> input, std::vector<double> answer);
+        /* Sizes are taken from the input and output layers */
+        double train(const double* input, const double* answer);
         std::vector<double> classify(std::vector<double> input);
+        /* Row-major batch of count inputs, returns count rows of outputs */
+        std::vector<double> classifyBatch(const double* inputs, size_t count, bool isParallel = true);
+        /* Adds the weight and bias changes of one train step to updates without applying them, returns the loss.
+           isParallel false keeps the work on the calling thread, for callers that run their own workers. */
+        double accumulateUpdates(const double* input, const double* answer, std::vector<std::valarray<double>>& updates, bool isParallel = true);
+        void applyUpdates(const std::vector<std::valarray<double>>& updates, double scale);
         void setLearningFactor(double factor);
+        void setDeterministic(bool deterministic);
+        bool isDeterministic() const;
+        /* Memory-lean training: train runs on buffers planned and allocated once, updates the weights in
+           place and keeps the activations of every checkpointInterval-th layer only, the others are
+           recomputed from the checkpoint below them during the backward pass. checkpointInterval 1 keeps
+           all activations, 0 picks about the square root of the layer count. Intervals past the output
+           layer are clamped to it. */
+        void setLeanTraining(bool lean, size_t checkpointInterval = 0);
+        bool isLeanTraining() const;
+        MemoryPlan getMemoryPlan() const;
         void clear();
+        /* Parameter block of every layer: weights followed by biases */
         std::vector<std::vector<double>> getWeights();
+        /* Zeroes the blockRows x blockCols weight blocks with the smallest norm, 1 x 1 prunes single weights */
+        void prune(double sparsity, int blockRows = 1, int blockCols = 1);
+        bool isPruned() const;
 
         static std::vector<double> randomizeWeights(double lowerLimit, double higherLimit, int countNeuronsLayerA, int countNeuronsLayerB);
+        /* Layers filled with one seed need distinct streams, the layer index as initializeWeights uses */
+        static std::vector<double> randomizeWeights(double lowerLimit, double higherLimit, int countNeuronsLayerA, int countNeuronsLayerB, uint64_t seed, uint32_t stream);
+        static std::vector<size_t> shuffleIndices(size_t count, uint64_t seed, uint32_t epoch);
 
     protected:
-        std::vector<vel> p_classify(std::vector<double> input);
+        std::vector<vel> p_classify(const double* input, bool isParallel = true);
         double p_applyActivationFunction(double value);
         vel p_applyActivationFunction(const vel& value);
         double p_applyActivationFunctionDerivative(double value);
         vel p_applyActivationFunctionDerivative(const vel& value);
         void p_backPropagation(double learningFactor, const std::vector<vel>& outputs, const vel& errors);
         vel p_calcOutputDeltas(const vel& inputs, const vel& error);
-        vel p_calcDefaultDeltas(const vel& inputs, const vel& weights, const vel& deltas);
+        vel p_calcDefaultDeltas(const vel& inputs, const vel& weights, const vel& deltas, bool isParallel = true);
         vel p_transposeFlatMatrix(const vel& flatMatrix, int width, int height);
         vel p_calcGradientW(const vel& output, const vel& delta);
+        void p_applyPruningMasks();
+        size_t p_countWeights(size_t layer) const;
+        double p_trainLean(const double* input, const double* answer);
+        void p_allocateMemoryPlan();
+        size_t p_layoutActivations(std::vector<size_t>& offsets) const;
+        size_t p_getCheckpointInterval() const;
+        size_t p_getTopSegment() const;
+        bool p_isCheckpoint(size_t layer) const;
+        void p_forwardLayer(size_t layer, const double* inputs, double* outputs);
+        void p_updateLayerInPlace(size_t layer, const double* outputs, const double* deltas);
+        void p_backPropagateDeltas(size_t layer, const double* outputs, const double* deltas, double* prevDeltas);
+        static double p_blockedDotProduct(const double* a, const double* b, size_t count, double init);
+        static double p_blockedDotProduct(const double* a, size_t strideA, const double* b, size_t count, double init);
+        static void p_fillUniform(double* data, size_t count, double lowerLimit, double higherLimit, uint64_t seed, uint32_t stream);
 
     private:
         double lFactor = 0.5;
         bool isInitialized = false;
+        bool deterministic = false;
+        bool leanTraining = false;
+        size_t checkpointInterval = 0;
         std::vector<int> layers;
+        /* weights[i] holds layers[i + 1] rows of layers[i] weights followed by layers[i + 1] biases */
         std::vector<vel> weights;
+        std::vector<vel> pruningMasks;
+
+        /* Memory plan of the lean training, dropped whenever the layers change */
+        std::vector<double> leanBuffer;
+        std::vector<size_t> activationOffsets;
+        std::vector<int> leanIndices;
+        size_t deltasOffset = 0;
     };
 }
\ No newline at end of file
@@ -0,0 +1,61 @@
+#include "pch.h"
+#include <windows.h>
+#include "Numa.h"
+
+#include <cassert>
+#define expect(x) assert(x)
+
+namespace NN
+{
+    size_t Numa::getCountNodes()
+    {
+        ULONG highestNode = 0;
+        if (!GetNumaHighestNodeNumber(&highestNode))
+            return 1;
+
+        return static_cast<size_t>(highestNode) + 1;
+    }
+    size_t Numa::getCountProcessors(size_t node)
+    {
+        GROUP_AFFINITY affinity = {};
+        if (!GetNumaNodeProcessorMaskEx(static_cast<USHORT>(node), &affinity))
+            return 0;
+
+        size_t count = 0;
+        for (KAFFINITY mask = affinity.Mask; mask != 0; mask &= mask - 1)
+            count++;
+
+        return count;
+    }
+    size_t Numa::getCurrentNode()
+    {
+        PROCESSOR_NUMBER processor = {};
+        GetCurrentProcessorNumberEx(&processor);
+
+        USHORT node = 0;
+        if (!GetNumaProcessorNodeEx(&processor, &node) || node == 0xFFFF)
+            return 0;
+
+        return node;
+    }
+    bool Numa::pinCurrentThread(size_t node)
+    {
+        expect(node < getCountNodes());
+
+        GROUP_AFFINITY affinity = {};
+        if (!GetNumaNodeProcessorMaskEx(static_cast<USHORT>(node), &affinity) || affinity.Mask == 0)
+            return false;
+
+        return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+    }
+    bool Numa::pinCurrentThreadToProcessor(size_t processor)
+    {
+        const size_t processorsPerGroup = sizeof(KAFFINITY) * 8;
+
+        GROUP_AFFINITY affinity = {};
+        affinity.Group = static_cast<WORD>(processor / processorsPerGroup);
+        affinity.Mask = static_cast<KAFFINITY>(1) << (processor % processorsPerGroup);
+
+        return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+
+namespace NN
+{
+    /* NUMA topology and thread placement. Memory placement relies on first touch: buffers allocated
+       and filled by a thread pinned to a node get their pages on that node. */
+    class Numa
+    {
+    public:
+        static size_t getCountNodes();
+        static size_t getCountProcessors(size_t node);
+        static size_t getCurrentNode();
+        static bool pinCurrentThread(size_t node);
+        static bool pinCurrentThreadToProcessor(size_t processor);
+    };
+}
\ No newline at end of file
@@ -0,0 +1,355 @@
+#include "pch.h"
+#include "NumaEngine.h"
+#include "Numa.h"
+
+#include <algorithm>
+#include <cassert>
+#define expect(x) assert(x)
+
+namespace NN
+{
+    NumaEngine::NumaEngine(NeuralNetwork& nn, std::shared_ptr<const Dataset> dataset, Options options)
+        :
+        nn(nn),
+        dataset(dataset),
+        options(options),
+        masterNode(Numa::getCurrentNode())
+    {
+        const auto& layers = nn.getLayers();
+
+        expect(layers.size() > 1);
+        expect(options.batchSize > 0);
+        expect(!dataset || dataset->getInputSize() == layers.front());
+        expect(!dataset || dataset->getAnswerSize() == layers.back());
+
+        /* Master side reduction buffer lives on the node of the owning thread */
+        for (const auto& weight : nn.getWeights())
+            totalUpdates.emplace_back(0.0, weight.size());
+
+        parameterBytes = p_countBytes(totalUpdates);
+
+        nodes.resize(Numa::getCountNodes());
+        for (size_t n = 0; n < nodes.size(); n++)
+        {
+            /* Memory-only nodes get no workers, a thread cannot be pinned to them */
+            const size_t countProcessors = Numa::getCountProcessors(n);
+
+            size_t countThreads = options.countThreadsPerNode;
+            if (countThreads == 0 || countProcessors == 0)
+                countThreads = countProcessors;
+
+            nodes[n].firstWorker = workers.size();
+            nodes[n].countWorkers = countThreads;
+
+            for (size_t i = 0; i < countThreads; i++)
+            {
+                workers.emplace_back();
+                workers.back().node = n;
+            }
+        }
+
+        /* Topology could not be read: unpinned workers, all counted as node 0 */
+        if (workers.empty())
+        {
+            size_t countThreads = options.countThreadsPerNode;
+            if (countThreads == 0)
+                countThreads = std::max(1u, std::thread::hardware_concurrency());
+
+            nodes.clear();
+            nodes.resize(1);
+            masterNode = 0;
+            nodes[0].countWorkers = countThreads;
+            workers.resize(countThreads);
+        }
+
+        for (size_t i = 0; i < workers.size(); i++)
+            threads.emplace_back(&NumaEngine::p_workerLoop, this, i);
+
+        p_runPhase(Phase::SETUP);
+    }
+    NumaEngine::~NumaEngine()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            phase = Phase::EXIT;
+            generation++;
+        }
+        cv.notify_all();
+
+        for (auto& thread : threads)
+            thread.join();
+    }
+    size_t NumaEngine::getCountNodes() const
+    {
+        return nodes.size();
+    }
+    size_t NumaEngine::getCountWorkers() const
+    {
+        return workers.size();
+    }
+    double NumaEngine::trainEpoch(uint32_t epoch)
+    {
+        expect(dataset);
+
+        this->epoch = epoch;
+
+        size_t countEpochSteps = 0;
+        for (const auto& worker : workers)
+            countEpochSteps = std::max(countEpochSteps, (worker.countRows + options.batchSize - 1) / options.batchSize);
+
+        double loss = 0;
+
+        for (step = 0; step < countEpochSteps; step++)
+        {
+            p_runPhase(Phase::COMPUTE);
+            p_runPhase(Phase::REDUCE);
+
+            /* Node sums are the only gradient data crossing nodes */
+            size_t countStepRows = 0;
+            for (auto& update : totalUpdates)
+                update = 0.0;
+
+            for (size_t n = 0; n < nodes.size(); n++)
+            {
+                if (nodes[n].countWorkers == 0)
+                    continue;
+
+                p_addUpdates(totalUpdates, nodes[n].updates);
+
+                if (n != masterNode)
+                    crossNodeReductionBytes += parameterBytes;
+            }
+
+            for (const auto& worker : workers)
+            {
+                countStepRows += worker.countStepRows;
+                loss += worker.stepLoss;
+            }
+
+            if (countStepRows > 0)
+                nn.applyUpdates(totalUpdates, 1.0 / countStepRows);
+
+            p_runPhase(Phase::SYNC);
+            countSteps++;
+        }
+
+        return loss / dataset->size();
+    }
+    std::vector<double> NumaEngine::classifyBatch(const double* inputs, size_t count)
+    {
+        expect(inputs != nullptr);
+
+        callerNode = Numa::getCurrentNode();
+        classifyInputs = inputs;
+        classifyCount = count;
+        classifyOutputs.assign(count * nn.getLayers().back(), 0);
+
+        p_runPhase(Phase::CLASSIFY);
+
+        return std::move(classifyOutputs);
+    }
+    void NumaEngine::synchronize()
+    {
+        p_runPhase(Phase::SYNC);
+    }
+    NumaEngine::Counters NumaEngine::getCounters() const
+    {
+        Counters counters;
+        counters.countSteps = countSteps;
+        counters.localReductionBytes = localReductionBytes;
+        counters.crossNodeReductionBytes = crossNodeReductionBytes;
+        counters.crossNodeSyncBytes = crossNodeSyncBytes;
+        counters.crossNodeInferenceBytes = crossNodeInferenceBytes;
+        counters.countUnpinnedWorkers = countUnpinnedWorkers;
+
+        return counters;
+    }
+    void NumaEngine::p_workerLoop(size_t index)
+    {
+        if (!Numa::pinCurrentThread(workers[index].node))
+            countUnpinnedWorkers++;
+
+        uint64_t seenGeneration = 0;
+
+        while (true)
+        {
+            Phase current;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&] { return generation != seenGeneration; });
+
+                seenGeneration = generation;
+                current = phase;
+            }
+
+            switch (current)
+            {
+            case Phase::EXIT:
+                return;
+            case Phase::SETUP:
+                p_setup(index);
+                break;
+            case Phase::COMPUTE:
+                p_compute(index);
+                break;
+            case Phase::REDUCE:
+                p_reduce(index);
+                break;
+            case Phase::SYNC:
+                p_sync(index);
+                break;
+            case Phase::CLASSIFY:
+                p_classify(index);
+                break;
+            default:
+                break;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                countFinished++;
+            }
+            cv.notify_all();
+        }
+    }
+    void NumaEngine::p_runPhase(Phase phase)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        this->phase = phase;
+        countFinished = 0;
+        generation++;
+        cv.notify_all();
+
+        cv.wait(lock, [&] { return countFinished == workers.size(); });
+        this->phase = Phase::IDLE;
+    }
+    void NumaEngine::p_setup(size_t index)
+    {
+        auto& worker = workers[index];
+        auto& node = nodes[worker.node];
+
+        /* Everything allocated here is first touched by a thread pinned to the worker's node */
+        if (dataset)
+        {
+            const size_t inputSize = dataset->getInputSize();
+            const size_t answerSize = dataset->getAnswerSize();
+
+            for (size_t row = index; row < dataset->size(); row += workers.size())
+            {
+                worker.inputs.insert(worker.inputs.end(), dataset->getInput(row), dataset->getInput(row) + inputSize);
+                worker.answers.insert(worker.answers.end(), dataset->getAnswer(row), dataset->getAnswer(row) + answerSize);
+                worker.countRows++;
+            }
+        }
+
+        for (const auto& update : totalUpdates)
+            worker.updates.emplace_back(0.0, update.size());
+
+        if (index != node.firstWorker)
+            return;
+
+        node.replica = std::make_unique<NeuralNetwork>(nn);
+
+        for (const auto& update : totalUpdates)
+            node.updates.emplace_back(0.0, update.size());
+
+        if (worker.node != masterNode)
+            crossNodeSyncBytes += parameterBytes;
+    }
+    void NumaEngine::p_compute(size_t index)
+    {
+        auto& worker = workers[index];
+        auto& replica = *nodes[worker.node].replica;
+
+        if (step == 0)
+        {
+            const uint64_t workerSeed = options.seed + index * 0x9E3779B97F4A7C15ull;
+            worker.order = NeuralNetwork::shuffleIndices(worker.countRows, workerSeed, epoch);
+        }
+
+        for (auto& update : worker.updates)
+            update = 0.0;
+
+        worker.countStepRows = 0;
+        worker.stepLoss = 0;
+
+        const size_t inputSize = dataset->getInputSize();
+        const size_t answerSize = dataset->getAnswerSize();
+        const size_t begin = std::min(step * options.batchSize, worker.countRows);
+        const size_t end = std::min(begin + options.batchSize, worker.countRows);
+
+        /* The replica is only read here, so the workers of a node share it. Workers are the parallelism,
+           a parallel step would move the work onto unpinned pool threads */
+        for (size_t i = begin; i < end; i++)
+        {
+            size_t row = worker.order[i];
+            worker.stepLoss += replica.accumulateUpdates(worker.inputs.data() + row * inputSize, worker.answers.data() + row * answerSize, worker.updates, false);
+            worker.countStepRows++;
+        }
+    }
+    void NumaEngine::p_reduce(size_t index)
+    {
+        auto& node = nodes[workers[index].node];
+
+        if (index != node.firstWorker)
+            return;
+
+        for (auto& update : node.updates)
+            update = 0.0;
+
+        for (size_t i = node.firstWorker; i < node.firstWorker + node.countWorkers; i++)
+            p_addUpdates(node.updates, workers[i].updates);
+
+        localReductionBytes += parameterBytes * node.countWorkers;
+    }
+    void NumaEngine::p_sync(size_t index)
+    {
+        auto& worker = workers[index];
+        auto& node = nodes[worker.node];
+
+        if (index != node.firstWorker)
+            return;
+
+        /* Same sizes, so the assignment reuses the replica's node-local storage */
+        *node.replica = nn;
+
+        if (worker.node != masterNode)
+            crossNodeSyncBytes += parameterBytes;
+    }
+    void NumaEngine::p_classify(size_t index)
+    {
+        auto& worker = workers[index];
+        auto& replica = *nodes[worker.node].replica;
+
+        const size_t inputSize = nn.getLayers().front();
+        const size_t outputSize = nn.getLayers().back();
+        const size_t begin = classifyCount * index / workers.size();
+        const size_t end = classifyCount * (index + 1) / workers.size();
+
+        if (begin == end)
+            return;
+
+        worker.outputs = replica.classifyBatch(classifyInputs + begin * inputSize, end - begin, false);
+        std::copy(worker.outputs.begin(), worker.outputs.end(), classifyOutputs.begin() + begin * outputSize);
+
+        if (worker.node != callerNode)
+            crossNodeInferenceBytes += (end - begin) * (inputSize + outputSize) * sizeof(double);
+    }
+    void NumaEngine::p_addUpdates(Updates& target, const Updates& source)
+    {
+        expect(target.size() == source.size());
+
+        for (size_t i = 0; i < target.size(); i++)
+            target[i] += source[i];
+    }
+    uint64_t NumaEngine::p_countBytes(const Updates& updates)
+    {
+        uint64_t size = 0;
+
+        for (const auto& update : updates)
+            size += update.size() * sizeof(double);
+
+        return size;
+    }
+}
\ No newline at end of file
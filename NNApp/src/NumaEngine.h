@@ -0,0 +1,135 @@
+#pragma once
+
+#include <vector>
+#include <valarray>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include "NeuralNetwork.h"
+#include "Dataset.h"
+
+namespace NN
+{
+    /* Multi-threaded training and batched inference with NUMA placement.
+       Workers are pinned to nodes and first-touch their dataset shard and update buffer. Every node
+       classifies and computes gradients against its own read-only replica of the weights. The only
+       cross-node traffic of a training step is the gradient reduction into the master network and
+       the replica refresh after it; the counters account for those bytes.
+       trainEpoch, classifyBatch and synchronize must not be called concurrently. */
+    class NumaEngine
+    {
+    public:
+        struct Options
+        {
+            size_t countThreadsPerNode = 0;     /* 0 is one per processor of the node, memory-only nodes get none */
+            size_t batchSize = 16;              /* rows per worker and step */
+            uint64_t seed = 0;
+        };
+
+        struct Counters
+        {
+            uint64_t countSteps = 0;
+            uint64_t localReductionBytes = 0;
+            uint64_t crossNodeReductionBytes = 0;
+            uint64_t crossNodeSyncBytes = 0;
+            uint64_t crossNodeInferenceBytes = 0;
+            size_t countUnpinnedWorkers = 0;    /* could not be pinned, their memory may be remote */
+        };
+
+    public:
+        /* dataset may be null for inference only */
+        NumaEngine(NeuralNetwork& nn, std::shared_ptr<const Dataset> dataset, Options options);
+        NumaEngine(const NumaEngine&) = delete;
+        NumaEngine& operator=(const NumaEngine&) = delete;
+        ~NumaEngine();
+        size_t getCountNodes() const;
+        size_t getCountWorkers() const;
+        /* Returns the mean loss of the epoch */
+        double trainEpoch(uint32_t epoch);
+        std::vector<double> classifyBatch(const double* inputs, size_t count);
+        /* Copies the master weights to the node replicas after nn was changed outside the engine */
+        void synchronize();
+        Counters getCounters() const;
+
+    protected:
+        using Updates = std::vector<std::valarray<double>>;
+
+        enum class Phase
+        {
+            IDLE,
+            SETUP,
+            COMPUTE,
+            REDUCE,
+            SYNC,
+            CLASSIFY,
+            EXIT
+        };
+
+        struct Node
+        {
+            std::unique_ptr<NeuralNetwork> replica;
+            Updates updates;
+            size_t firstWorker = 0;
+            size_t countWorkers = 0;
+        };
+
+        struct Worker
+        {
+            size_t node = 0;
+            std::vector<double> inputs;
+            std::vector<double> answers;
+            size_t countRows = 0;
+            std::vector<size_t> order;
+            Updates updates;
+            size_t countStepRows = 0;
+            double stepLoss = 0;
+            std::vector<double> outputs;
+        };
+
+        void p_workerLoop(size_t index);
+        void p_runPhase(Phase phase);
+        void p_setup(size_t index);
+        void p_compute(size_t index);
+        void p_reduce(size_t index);
+        void p_sync(size_t index);
+        void p_classify(size_t index);
+        static void p_addUpdates(Updates& target, const Updates& source);
+        static uint64_t p_countBytes(const Updates& updates);
+
+    private:
+        NeuralNetwork& nn;
+        std::shared_ptr<const Dataset> dataset;
+        Options options;
+        size_t masterNode = 0;
+        uint64_t parameterBytes = 0;
+        Updates totalUpdates;
+        std::vector<Node> nodes;
+        std::vector<Worker> workers;
+        std::vector<std::thread> threads;
+
+        /* Phase dispatch: the calling thread publishes a phase and waits for every worker */
+        std::mutex mutex;
+        std::condition_variable cv;
+        Phase phase = Phase::IDLE;
+        uint64_t generation = 0;
+        size_t countFinished = 0;
+
+        /* Arguments of the running phase */
+        uint32_t epoch = 0;
+        size_t step = 0;
+        size_t callerNode = 0;
+        const double* classifyInputs = nullptr;
+        size_t classifyCount = 0;
+        std::vector<double> classifyOutputs;
+
+        std::atomic<uint64_t> countSteps{ 0 };
+        std::atomic<uint64_t> localReductionBytes{ 0 };
+        std::atomic<uint64_t> crossNodeReductionBytes{ 0 };
+        std::atomic<uint64_t> crossNodeSyncBytes{ 0 };
+        std::atomic<uint64_t> crossNodeInferenceBytes{ 0 };
+        std::atomic<size_t> countUnpinnedWorkers{ 0 };
+    };
+}
\ No newline at end of file
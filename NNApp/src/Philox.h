@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace NN
+{
+    /* Counter-based Philox4x32-10 generator (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3").
+       Output depends only on (seed, stream, counter), so any thread can draw any element. */
+    class Philox
+    {
+    public:
+        using Block = std::array<uint32_t, 4>;
+
+    public:
+        explicit Philox(uint64_t seed)
+            :
+            key{ static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32) }
+        {
+        }
+        Block operator()(uint64_t counter, uint32_t stream) const
+        {
+            Block ctr = { static_cast<uint32_t>(counter), static_cast<uint32_t>(counter >> 32), stream, 0 };
+            std::array<uint32_t, 2> k = key;
+
+            for (int i = 0; i < ROUNDS; i++)
+            {
+                uint64_t p0 = static_cast<uint64_t>(MULTIPLIER_0) * ctr[0];
+                uint64_t p1 = static_cast<uint64_t>(MULTIPLIER_1) * ctr[2];
+
+                ctr = {
+                    static_cast<uint32_t>(p1 >> 32) ^ ctr[1] ^ k[0],
+                    static_cast<uint32_t>(p1),
+                    static_cast<uint32_t>(p0 >> 32) ^ ctr[3] ^ k[1],
+                    static_cast<uint32_t>(p0)
+                };
+
+                k[0] += WEYL_0;
+                k[1] += WEYL_1;
+            }
+
+            return ctr;
+        }
+        /* Maps a raw output to [0, 1) */
+        static double toUnit(uint32_t value)
+        {
+            return value * (1.0 / 4294967296.0);
+        }
+
+    private:
+        static constexpr int ROUNDS = 10;
+        static constexpr uint32_t MULTIPLIER_0 = 0xD2511F53;
+        static constexpr uint32_t MULTIPLIER_1 = 0xCD9E8D57;
+        static constexpr uint32_t WEYL_0 = 0x9E3779B9;
+        static constexpr uint32_t WEYL_1 = 0xBB67AE85;
+
+    private:
+        std::array<uint32_t, 2> key;
+    };
+}
\ No newline at end of file
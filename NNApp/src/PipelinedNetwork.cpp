@@ -0,0 +1,286 @@
+#include "pch.h"
+#include "PipelinedNetwork.h"
+#include "Numa.h"
+
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+#define expect(x) assert(x)
+
+namespace NN
+{
+    double PipelinedNetwork::BenchmarkResult::getSpeedup() const
+    {
+        if (pipelinedSeconds == 0)
+            return 0;
+
+        return batchedSeconds / pipelinedSeconds;
+    }
+    PipelinedNetwork::Channel::Channel(size_t capacity)
+        :
+        queue(capacity)
+    {
+    }
+    PipelinedNetwork::PipelinedNetwork(NeuralNetwork& nn, size_t countStages, size_t microBatchSize)
+        :
+        nn(nn),
+        microBatchSize(microBatchSize)
+    {
+        expect(nn.getLayers().size() > 1);
+        expect(microBatchSize > 0);
+
+        if (countStages == 0)
+            countStages = std::max(1u, std::thread::hardware_concurrency());
+
+        p_partition(std::min(countStages, nn.getLayers().size() - 1));
+
+        for (size_t i = 0; i <= stages.size(); i++)
+            channels.push_back(std::make_unique<Channel>(QUEUE_CAPACITY));
+
+        for (size_t i = 0; i < stages.size(); i++)
+        {
+            stages[i].input = channels[i].get();
+            stages[i].output = channels[i + 1].get();
+        }
+
+        for (size_t i = 0; i < stages.size(); i++)
+            threads.emplace_back(&PipelinedNetwork::p_stageLoop, this, i);
+
+        /* Stages copy their layers from nn, which must stay untouched until they are done */
+        while (countReadyStages != stages.size())
+            std::this_thread::yield();
+    }
+    PipelinedNetwork::~PipelinedNetwork()
+    {
+        isStopping = true;
+
+        for (auto& channel : channels)
+        {
+            {
+                std::lock_guard<std::mutex> lock(channel->mutex);
+            }
+            channel->cv.notify_all();
+        }
+
+        for (auto& thread : threads)
+            thread.join();
+
+        for (auto& channel : channels)
+        {
+            MicroBatch* batch = nullptr;
+            while (channel->queue.tryPop(batch))
+                delete batch;
+        }
+    }
+    size_t PipelinedNetwork::getCountStages() const
+    {
+        return stages.size();
+    }
+    std::vector<size_t> PipelinedNetwork::getStageLayers() const
+    {
+        std::vector<size_t> stageLayers;
+
+        for (const auto& stage : stages)
+            stageLayers.push_back(stage.firstLayer);
+
+        return stageLayers;
+    }
+    std::vector<double> PipelinedNetwork::classifyBatch(const double* inputs, size_t count)
+    {
+        expect(inputs != nullptr);
+
+        const size_t inputSize = nn.getLayers().front();
+        const size_t outputSize = nn.getLayers().back();
+
+        std::vector<double> outputs(count * outputSize);
+        Channel& first = *channels.front();
+        Channel& last = *channels.back();
+
+        size_t countSent = 0;
+        size_t countReceived = 0;
+        size_t countIdle = 0;
+        MicroBatch* pending = nullptr;
+
+        /* The caller feeds the first stage and drains the last one, so a full pipeline cannot stall it */
+        while (countReceived < count)
+        {
+            bool isProgress = false;
+
+            if (!pending && countSent < count)
+            {
+                pending = new MicroBatch;
+                pending->first = countSent;
+                pending->count = std::min(microBatchSize, count - countSent);
+                pending->values.assign(inputs + countSent * inputSize, inputs + (countSent + pending->count) * inputSize);
+                countSent += pending->count;
+            }
+
+            if (pending && p_tryPush(first, pending))
+            {
+                pending = nullptr;
+                isProgress = true;
+            }
+
+            MicroBatch* done = nullptr;
+            if (last.queue.tryPop(done))
+            {
+                std::copy(done->values.begin(), done->values.end(), outputs.begin() + done->first * outputSize);
+                countReceived += done->count;
+                delete done;
+                isProgress = true;
+            }
+
+            if (isProgress)
+            {
+                countIdle = 0;
+                continue;
+            }
+
+            if (++countIdle < COUNT_IDLE_SPINS)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            /* Nothing moved, so micro-batches are in flight and the last stage will push one */
+            std::unique_lock<std::mutex> lock(last.mutex);
+            last.cv.wait(lock, [&] { return !last.queue.isEmpty(); });
+        }
+
+        return outputs;
+    }
+    PipelinedNetwork::BenchmarkResult PipelinedNetwork::benchmark(NeuralNetwork& nn, const double* inputs, size_t count, size_t countRepeats)
+    {
+        expect(nn.getLayers() == this->nn.getLayers());
+        expect(countRepeats > 0);
+
+        using Clock = std::chrono::steady_clock;
+        BenchmarkResult result;
+        std::vector<double> batched;
+        std::vector<double> pipelined;
+
+        /* Stages are parked by now, the batched path gets every core */
+        auto batchedStart = Clock::now();
+        for (size_t i = 0; i < countRepeats; i++)
+            batched = nn.classifyBatch(inputs, count);
+        std::chrono::duration<double> batchedTime = Clock::now() - batchedStart;
+
+        auto pipelinedStart = Clock::now();
+        for (size_t i = 0; i < countRepeats; i++)
+            pipelined = classifyBatch(inputs, count);
+        std::chrono::duration<double> pipelinedTime = Clock::now() - pipelinedStart;
+
+        result.batchedSeconds = batchedTime.count();
+        result.pipelinedSeconds = pipelinedTime.count();
+
+        for (size_t i = 0; i < batched.size(); i++)
+            result.maxDifference = std::max(result.maxDifference, std::abs(batched[i] - pipelined[i]));
+
+        return result;
+    }
+    void PipelinedNetwork::p_partition(size_t countStages)
+    {
+        const auto& layers = nn.getLayers();
+        const size_t countWeightLayers = layers.size() - 1;
+
+        /* Balance stages by multiply-adds, every stage gets at least one weight layer */
+        std::vector<double> costs;
+        double totalCost = 0;
+        for (size_t i = 0; i < countWeightLayers; i++)
+        {
+            costs.push_back(static_cast<double>(layers[i]) * layers[i + 1]);
+            totalCost += costs.back();
+        }
+
+        size_t layer = 0;
+        double doneCost = 0;
+
+        for (size_t s = 0; s < countStages; s++)
+        {
+            Stage stage;
+            stage.firstLayer = layer;
+
+            const size_t countRemainingStages = countStages - s - 1;
+            const double targetCost = totalCost * (s + 1) / countStages;
+
+            do
+            {
+                doneCost += costs[layer];
+                layer++;
+            } while (layer < countWeightLayers - countRemainingStages && doneCost + costs[layer] / 2 <= targetCost);
+
+            stage.lastLayer = layer;
+            stages.push_back(std::move(stage));
+        }
+
+        stages.back().lastLayer = countWeightLayers;
+    }
+    void PipelinedNetwork::p_stageLoop(size_t index)
+    {
+        auto& stage = stages[index];
+
+        Numa::pinCurrentThreadToProcessor(index % std::max(1u, std::thread::hardware_concurrency()));
+
+        /* Built by the stage thread so the weights are first touched next to the core using them */
+        stage.layers = std::make_unique<NeuralNetwork>();
+        for (size_t l = stage.firstLayer; l <= stage.lastLayer; l++)
+            stage.layers->pushLayer(nn.getLayers()[l]);
+
+        for (size_t l = stage.firstLayer; l < stage.lastLayer; l++)
+            stage.layers->setupWeights(l - stage.firstLayer, l - stage.firstLayer + 1, nn.getWeights(l, l + 1), nn.getBiases(l, l + 1));
+
+        countReadyStages++;
+
+        size_t countIdle = 0;
+
+        while (true)
+        {
+            MicroBatch* batch = nullptr;
+
+            if (!stage.input->queue.tryPop(batch))
+            {
+                if (isStopping)
+                    return;
+
+                /* Spin briefly while micro-batches are streaming, then park */
+                if (++countIdle < COUNT_IDLE_SPINS)
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lock(stage.input->mutex);
+                stage.input->cv.wait(lock, [&] { return isStopping || !stage.input->queue.isEmpty(); });
+                continue;
+            }
+
+            countIdle = 0;
+            batch->values = stage.layers->classifyBatch(batch->values.data(), batch->count, false);
+
+            while (!p_tryPush(*stage.output, batch))
+            {
+                if (isStopping)
+                {
+                    delete batch;
+                    return;
+                }
+
+                std::this_thread::yield();
+            }
+        }
+    }
+    bool PipelinedNetwork::p_tryPush(Channel& channel, MicroBatch* batch)
+    {
+        if (!channel.queue.tryPush(batch))
+            return false;
+
+        /* Taking the mutex orders the push before a consumer that is about to park */
+        {
+            std::lock_guard<std::mutex> lock(channel.mutex);
+        }
+        channel.cv.notify_one();
+
+        return true;
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include "NeuralNetwork.h"
+#include "SpscQueue.h"
+
+namespace NN
+{
+    /* Layer-pipelined inference. Contiguous groups of layers are assigned to stages, every stage runs
+       on its own pinned thread with a private copy of its layers, and micro-batches stream between
+       stages through lock-free SPSC queues. A stage whose queue stays empty parks until the next push,
+       so an idle pipeline does not occupy its cores. Outputs are bit-identical to NeuralNetwork::classifyBatch. */
+    class PipelinedNetwork
+    {
+    public:
+        struct BenchmarkResult
+        {
+            double batchedSeconds = 0;
+            double pipelinedSeconds = 0;
+            double maxDifference = 0;
+
+            double getSpeedup() const;
+        };
+
+    public:
+        /* countStages 0 is one stage per hardware thread, never more than the number of weight layers */
+        PipelinedNetwork(NeuralNetwork& nn, size_t countStages = 0, size_t microBatchSize = 16);
+        PipelinedNetwork(const PipelinedNetwork&) = delete;
+        PipelinedNetwork& operator=(const PipelinedNetwork&) = delete;
+        ~PipelinedNetwork();
+        size_t getCountStages() const;
+        /* First layer of every stage, the last stage ends at the output layer */
+        std::vector<size_t> getStageLayers() const;
+        /* Row-major batch of count inputs, returns count rows of outputs. One caller at a time. */
+        std::vector<double> classifyBatch(const double* inputs, size_t count);
+        /* Compares against the non-pipelined nn.classifyBatch on the same inputs */
+        BenchmarkResult benchmark(NeuralNetwork& nn, const double* inputs, size_t count, size_t countRepeats);
+
+    protected:
+        struct MicroBatch
+        {
+            size_t first = 0;
+            size_t count = 0;
+            std::vector<double> values;
+        };
+
+        struct Channel
+        {
+            explicit Channel(size_t capacity);
+
+            SpscQueue<MicroBatch*> queue;
+            /* The consumer parks here once the queue stays empty */
+            std::mutex mutex;
+            std::condition_variable cv;
+        };
+
+        struct Stage
+        {
+            size_t firstLayer = 0;
+            size_t lastLayer = 0;
+            std::unique_ptr<NeuralNetwork> layers;
+            Channel* input = nullptr;
+            Channel* output = nullptr;
+        };
+
+        void p_partition(size_t countStages);
+        void p_stageLoop(size_t index);
+        static bool p_tryPush(Channel& channel, MicroBatch* batch);
+
+    private:
+        static constexpr size_t QUEUE_CAPACITY = 8;
+        static constexpr size_t COUNT_IDLE_SPINS = 64;
+
+        NeuralNetwork& nn;
+        size_t microBatchSize;
+        std::vector<Stage> stages;
+        std::vector<std::unique_ptr<Channel>> channels;
+        std::vector<std::thread> threads;
+        std::atomic<size_t> countReadyStages{ 0 };
+        std::atomic<bool> isStopping{ false };
+    };
+}
\ No newline at end of file
@@ -0,0 +1,253 @@
+#include "pch.h"
+#include "SparseNetwork.h"
+
+#include <chrono>
+#include <cmath>
+#include <cassert>
+#define expect(x) assert(x)
+
+namespace NN
+{
+    double SparseNetwork::Report::getSizeReduction() const
+    {
+        if (sparseBytes == 0)
+            return 0;
+
+        return static_cast<double>(denseBytes) / sparseBytes;
+    }
+    double SparseNetwork::Report::getLatencyReduction() const
+    {
+        if (sparseLatency == 0)
+            return 0;
+
+        return denseLatency / sparseLatency;
+    }
+    SparseNetwork::SparseNetwork(NeuralNetwork& nn, double densityThreshold)
+        :
+        densityThreshold(densityThreshold),
+        layers(nn.getLayers())
+    {
+        expect(densityThreshold >= 0);
+        expect(densityThreshold <= 1);
+        expect(layers.size() > 1);
+
+        auto weights = nn.getWeights();
+        expect(weights.size() == layers.size() - 1);
+
+        for (size_t i = 0; i < weights.size(); i++)
+            sLayers.push_back(p_makeLayer(weights[i], layers[i], layers[i + 1]));
+    }
+    std::vector<double> SparseNetwork::classify(const std::vector<double>& input) const
+    {
+        return p_classify(sLayers, input);
+    }
+    size_t SparseNetwork::getCountLayers() const
+    {
+        return sLayers.size();
+    }
+    double SparseNetwork::getLayerDensity(size_t layer) const
+    {
+        return sLayers.at(layer).density;
+    }
+    double SparseNetwork::getLayerBlockDensity(size_t layer) const
+    {
+        return sLayers.at(layer).blockDensity;
+    }
+    bool SparseNetwork::isLayerSparse(size_t layer) const
+    {
+        return sLayers.at(layer).isSparse;
+    }
+    size_t SparseNetwork::getSizeInBytes() const
+    {
+        size_t size = 0;
+
+        for (const auto& layer : sLayers)
+        {
+            size += layer.countOutputs * sizeof(double);
+            size += layer.weights.size() * sizeof(double);
+            size += layer.blockRowOffsets.size() * sizeof(size_t);
+            size += layer.blockColumns.size() * sizeof(int);
+            size += layer.blocks.size() * sizeof(double);
+        }
+
+        return size;
+    }
+    SparseNetwork::Report SparseNetwork::compare(NeuralNetwork& nn, const std::vector<std::vector<double>>& samples) const
+    {
+        expect(nn.getLayers() == layers);
+        expect(samples.size() > 0);
+
+        using Clock = std::chrono::steady_clock;
+        Report report;
+
+        for (const auto& weight : nn.getWeights())
+            report.denseBytes += weight.size() * sizeof(double);
+
+        report.sparseBytes = getSizeInBytes();
+
+        for (const auto& layer : sLayers)
+            if (layer.isSparse)
+                report.countSparseLayers++;
+
+        /* Baseline runs the dense kernel of this engine on every layer, so only the sparsity differs */
+        auto weights = nn.getWeights();
+        std::vector<Layer> denseLayers;
+        for (size_t i = 0; i < weights.size(); i++)
+            denseLayers.push_back(p_makeLayer(weights[i], layers[i], layers[i + 1], false));
+
+        /* Sink keeps the optimizer from dropping the classifications */
+        volatile double sink = 0;
+
+        auto denseStart = Clock::now();
+        for (const auto& sample : samples)
+            sink = sink + p_classify(denseLayers, sample).front();
+        std::chrono::duration<double> denseTime = Clock::now() - denseStart;
+
+        auto sparseStart = Clock::now();
+        for (const auto& sample : samples)
+            sink = sink + classify(sample).front();
+        std::chrono::duration<double> sparseTime = Clock::now() - sparseStart;
+
+        report.denseLatency = denseTime.count() / samples.size();
+        report.sparseLatency = sparseTime.count() / samples.size();
+
+        return report;
+    }
+    SparseNetwork::Layer SparseNetwork::p_makeLayer(const std::vector<double>& parameters, int countInputs, int countOutputs, bool isSparseAllowed) const
+    {
+        const size_t countWeights = static_cast<size_t>(countInputs) * countOutputs;
+        expect(parameters.size() == countWeights + countOutputs);
+
+        std::vector<double> weights(parameters.begin(), parameters.begin() + countWeights);
+
+        Layer layer;
+        layer.countInputs = countInputs;
+        layer.countOutputs = countOutputs;
+        layer.biases.assign(p_roundUp(countOutputs, BLOCK_ROWS), 0);
+        std::copy(parameters.begin() + countWeights, parameters.end(), layer.biases.begin());
+
+        size_t countNonZero = 0;
+        for (const auto& weight : weights)
+            if (weight != 0)
+                countNonZero++;
+
+        layer.density = static_cast<double>(countNonZero) / weights.size();
+
+        const int countBlockRows = p_roundUp(countOutputs, BLOCK_ROWS) / BLOCK_ROWS;
+        const int countBlockCols = p_roundUp(countInputs, BLOCK_COLS) / BLOCK_COLS;
+
+        layer.blockRowOffsets.push_back(0);
+
+        for (int br = 0; br < countBlockRows; br++)
+        {
+            for (int bc = 0; bc < countBlockCols; bc++)
+            {
+                double block[BLOCK_ROWS * BLOCK_COLS] = {};
+                bool isEmpty = true;
+
+                for (int r = 0; r < BLOCK_ROWS; r++)
+                {
+                    int row = br * BLOCK_ROWS + r;
+                    for (int c = 0; c < BLOCK_COLS; c++)
+                    {
+                        int col = bc * BLOCK_COLS + c;
+                        if (row < countOutputs && col < countInputs)
+                        {
+                            block[r * BLOCK_COLS + c] = weights[static_cast<size_t>(row) * countInputs + col];
+                            isEmpty = isEmpty && block[r * BLOCK_COLS + c] == 0;
+                        }
+                    }
+                }
+
+                if (isEmpty)
+                    continue;
+
+                layer.blockColumns.push_back(bc);
+                layer.blocks.insert(layer.blocks.end(), std::begin(block), std::end(block));
+            }
+
+            layer.blockRowOffsets.push_back(layer.blockColumns.size());
+        }
+
+        /* Sparse kernel cost is proportional to the stored blocks, not to the non-zero weights */
+        layer.blockDensity = static_cast<double>(layer.blockColumns.size()) / (static_cast<size_t>(countBlockRows) * countBlockCols);
+        layer.isSparse = isSparseAllowed && layer.blockDensity <= densityThreshold;
+
+        if (!layer.isSparse)
+        {
+            layer.weights = weights;
+            layer.blockRowOffsets.clear();
+            layer.blockColumns.clear();
+            layer.blocks.clear();
+        }
+
+        return layer;
+    }
+    void SparseNetwork::p_denseForward(const Layer& layer, const double* input, double* output) const
+    {
+        for (int j = 0; j < layer.countOutputs; j++)
+        {
+            const double* row = layer.weights.data() + static_cast<size_t>(j) * layer.countInputs;
+            double sum = layer.biases[j];
+
+            for (int k = 0; k < layer.countInputs; k++)
+                sum += row[k] * input[k];
+
+            output[j] = sum;
+        }
+    }
+    void SparseNetwork::p_sparseForward(const Layer& layer, const double* input, double* output) const
+    {
+        const int countBlockRows = static_cast<int>(layer.blockRowOffsets.size()) - 1;
+
+        for (int br = 0; br < countBlockRows; br++)
+        {
+            double acc[BLOCK_ROWS];
+            for (int r = 0; r < BLOCK_ROWS; r++)
+                acc[r] = layer.biases[br * BLOCK_ROWS + r];
+
+            for (size_t b = layer.blockRowOffsets[br]; b < layer.blockRowOffsets[br + 1]; b++)
+            {
+                const double* block = layer.blocks.data() + b * BLOCK_ROWS * BLOCK_COLS;
+                const double* x = input + static_cast<size_t>(layer.blockColumns[b]) * BLOCK_COLS;
+
+                for (int r = 0; r < BLOCK_ROWS; r++)
+                    for (int c = 0; c < BLOCK_COLS; c++)
+                        acc[r] += block[r * BLOCK_COLS + c] * x[c];
+            }
+
+            for (int r = 0; r < BLOCK_ROWS; r++)
+                output[br * BLOCK_ROWS + r] = acc[r];
+        }
+    }
+    std::vector<double> SparseNetwork::p_classify(const std::vector<Layer>& classifyLayers, const std::vector<double>& input) const
+    {
+        expect(input.size() == static_cast<size_t>(layers.front()));
+
+        /* Buffers are padded to whole blocks, padding stays zero between layers */
+        std::vector<double> current(p_roundUp(layers.front(), BLOCK_COLS), 0);
+        std::copy(input.begin(), input.end(), current.begin());
+
+        for (const auto& layer : classifyLayers)
+        {
+            std::vector<double> next(p_roundUp(p_roundUp(layer.countOutputs, BLOCK_ROWS), BLOCK_COLS), 0);
+
+            if (layer.isSparse)
+                p_sparseForward(layer, current.data(), next.data());
+            else
+                p_denseForward(layer, current.data(), next.data());
+
+            for (int j = 0; j < layer.countOutputs; j++)
+                next[j] = 1 / (1 + std::exp(-next[j]));
+
+            current = std::move(next);
+        }
+
+        current.resize(layers.back());
+        return current;
+    }
+    int SparseNetwork::p_roundUp(int value, int multiple)
+    {
+        return (value + multiple - 1) / multiple * multiple;
+    }
+}
\ No newline at end of file
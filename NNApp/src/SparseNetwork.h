@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+#include "NeuralNetwork.h"
+
+namespace NN
+{
+    /* Inference-only copy of a (pruned) NeuralNetwork. Every layer is stored either dense or
+       in block sparse row (BSR) format, chosen by the block density measured on construction. */
+    class SparseNetwork
+    {
+    public:
+        /* 4 doubles per block row fill one AVX register */
+        static constexpr int BLOCK_ROWS = 4;
+        static constexpr int BLOCK_COLS = 4;
+        static constexpr double DEFAULT_DENSITY_THRESHOLD = 0.4;
+
+        struct Report
+        {
+            size_t denseBytes = 0;
+            size_t sparseBytes = 0;
+            double denseLatency = 0;
+            double sparseLatency = 0;
+            size_t countSparseLayers = 0;
+
+            double getSizeReduction() const;
+            double getLatencyReduction() const;
+        };
+
+    public:
+        SparseNetwork(NeuralNetwork& nn, double densityThreshold = DEFAULT_DENSITY_THRESHOLD);
+        std::vector<double> classify(const std::vector<double>& input) const;
+        size_t getCountLayers() const;
+        double getLayerDensity(size_t layer) const;
+        double getLayerBlockDensity(size_t layer) const;
+        bool isLayerSparse(size_t layer) const;
+        size_t getSizeInBytes() const;
+        Report compare(NeuralNetwork& nn, const std::vector<std::vector<double>>& samples) const;
+
+    protected:
+        struct Layer
+        {
+            int countInputs = 0;
+            int countOutputs = 0;
+            double density = 0;
+            double blockDensity = 0;
+            bool isSparse = false;
+
+            /* Padded to whole block rows, initializes the accumulators of both kernels */
+            std::vector<double> biases;
+
+            /* Dense storage: countOutputs rows of countInputs weights */
+            std::vector<double> weights;
+
+            /* BSR storage: blockColumns[blockRowOffsets[r]..blockRowOffsets[r + 1]) are the
+               non-empty blocks of block row r, their values are in blocks row-major */
+            std::vector<size_t> blockRowOffsets;
+            std::vector<int> blockColumns;
+            std::vector<double> blocks;
+        };
+
+        /* isSparseAllowed false keeps the layer dense whatever its block density */
+        Layer p_makeLayer(const std::vector<double>& parameters, int countInputs, int countOutputs, bool isSparseAllowed = true) const;
+        std::vector<double> p_classify(const std::vector<Layer>& classifyLayers, const std::vector<double>& input) const;
+        void p_denseForward(const Layer& layer, const double* input, double* output) const;
+        void p_sparseForward(const Layer& layer, const double* input, double* output) const;
+        static int p_roundUp(int value, int multiple);
+
+    private:
+        double densityThreshold;
+        std::vector<int> layers;
+        std::vector<Layer> sLayers;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+namespace NN
+{
+    /* Bounded lock-free queue for exactly one producer thread and one consumer thread */
+    template<typename T>
+    class SpscQueue
+    {
+    public:
+        explicit SpscQueue(size_t capacity)
+            :
+            buffer(capacity + 1)
+        {
+        }
+        bool tryPush(const T& value)
+        {
+            size_t tail = this->tail.load(std::memory_order_relaxed);
+            size_t next = p_next(tail);
+
+            if (next == head.load(std::memory_order_acquire))
+                return false;
+
+            buffer[tail] = value;
+            this->tail.store(next, std::memory_order_release);
+            return true;
+        }
+        bool tryPop(T& value)
+        {
+            size_t head = this->head.load(std::memory_order_relaxed);
+
+            if (head == tail.load(std::memory_order_acquire))
+                return false;
+
+            value = buffer[head];
+            this->head.store(p_next(head), std::memory_order_release);
+            return true;
+        }
+        /* Consumer side only */
+        bool isEmpty() const
+        {
+            return head.load(std::memory_order_relaxed) == tail.load(std::memory_order_acquire);
+        }
+
+    private:
+        size_t p_next(size_t index) const
+        {
+            return index + 1 == buffer.size() ? 0 : index + 1;
+        }
+
+    private:
+        /* One slot stays empty to tell a full queue from an empty one */
+        std::vector<T> buffer;
+
+        /* Producer and consumer indices on separate cache lines */
+        alignas(64) std::atomic<size_t> head{ 0 };
+        alignas(64) std::atomic<size_t> tail{ 0 };
+    };
+}
\ No newline at end of file
@@ -0,0 +1,238 @@
+#include "pch.h"
+#include "SweepRunner.h"
+
+#include <thread>
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+#include <cmath>
+#include <cassert>
+#define expect(x) assert(x)
+
+namespace NN
+{
+    SweepRunner::SweepRunner(std::shared_ptr<const Dataset> dataset, Options options)
+        :
+        dataset(dataset),
+        options(options)
+    {
+        expect(dataset && dataset->size() > 0);
+        expect(options.countEpochs > 0);
+        expect(options.countRungEpochs > 0);
+        expect(options.keepFraction > 0);
+        expect(options.keepFraction <= 1);
+    }
+    std::vector<SweepRunner::Result> SweepRunner::run(const std::vector<Configuration>& configurations)
+    {
+        trials.clear();
+        rungLosses.clear();
+
+        for (const auto& configuration : configurations)
+        {
+            expect(configuration.layers.size() > 1);
+            expect(configuration.layers.front() == dataset->getInputSize());
+            expect(configuration.layers.back() == dataset->getAnswerSize());
+
+            auto trial = std::make_unique<Trial>();
+            trial->configuration = configuration;
+
+            for (const auto& layer : configuration.layers)
+                trial->nn.pushLayer(layer);
+
+            trial->nn.initializeWeights(configuration.seed, configuration.initialization);
+            trial->nn.setLearningFactor(configuration.learningFactor);
+            trials.push_back(std::move(trial));
+        }
+
+        size_t countThreads = options.countThreads;
+        if (countThreads == 0)
+            countThreads = std::max(1u, std::thread::hardware_concurrency());
+        countThreads = std::max<size_t>(1, std::min(countThreads, trials.size()));
+
+        queues.clear();
+        for (size_t i = 0; i < countThreads; i++)
+            queues.push_back(std::make_unique<WorkerQueue>());
+
+        for (size_t i = 0; i < trials.size(); i++)
+            queues[i % countThreads]->trials.push_back(i);
+
+        countPending = trials.size();
+        countQueued = trials.size();
+
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < countThreads; i++)
+            workers.emplace_back(&SweepRunner::p_worker, this, i);
+
+        for (auto& worker : workers)
+            worker.join();
+
+        std::vector<Result> results;
+        for (const auto& trial : trials)
+        {
+            Result result;
+            result.configuration = trial->configuration;
+            result.loss = trial->loss;
+            result.countEpochs = trial->countEpochs;
+            result.isStopped = trial->isStopped;
+            results.push_back(result);
+        }
+
+        /* Completed configurations rank above the ones stopped early */
+        std::stable_sort(results.begin(), results.end(), [](const Result& a, const Result& b)
+        {
+            if (a.isStopped != b.isStopped)
+                return !a.isStopped;
+
+            return a.loss < b.loss;
+        });
+
+        return results;
+    }
+    std::wstring SweepRunner::formatResults(const std::vector<Result>& results)
+    {
+        std::wstringstream ss;
+        ss << std::left
+            << std::setw(6) << L"rank"
+            << std::setw(24) << L"layers"
+            << std::setw(10) << L"factor"
+            << std::setw(12) << L"seed"
+            << std::setw(8) << L"epochs"
+            << std::setw(14) << L"loss"
+            << L"status\n";
+
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const auto& result = results[i];
+
+            std::wstringstream layers;
+            for (size_t j = 0; j < result.configuration.layers.size(); j++)
+            {
+                layers << result.configuration.layers[j];
+                if (j != result.configuration.layers.size() - 1)
+                    layers << L',';
+            }
+
+            ss << std::setw(6) << i + 1
+                << std::setw(24) << layers.str()
+                << std::setw(10) << result.configuration.learningFactor
+                << std::setw(12) << result.configuration.seed
+                << std::setw(8) << result.countEpochs
+                << std::setw(14) << result.loss
+                << (result.isStopped ? L"stopped" : L"completed") << L'\n';
+        }
+
+        return ss.str();
+    }
+    void SweepRunner::p_worker(size_t index)
+    {
+        while (true)
+        {
+            size_t trialIndex = 0;
+
+            if (!p_popTask(index, trialIndex))
+            {
+                std::unique_lock<std::mutex> lock(idleMutex);
+                idleCv.wait(lock, [&] { return countQueued > 0 || countPending == 0; });
+
+                if (countPending == 0)
+                    return;
+
+                continue;
+            }
+
+            auto& trial = *trials[trialIndex];
+            p_trainRung(trial);
+
+            size_t rung = (trial.countEpochs - 1) / options.countRungEpochs;
+            bool isCompleted = trial.countEpochs >= options.countEpochs;
+
+            if (!isCompleted && p_shouldContinue(rung, trial.loss))
+            {
+                /* Continuing on the same worker keeps the network in this core's cache */
+                {
+                    std::lock_guard<std::mutex> lock(queues[index]->mutex);
+                    queues[index]->trials.push_back(trialIndex);
+                    countQueued++;
+                }
+
+                p_notifyWorkers();
+                continue;
+            }
+
+            trial.isStopped = !isCompleted;
+            countPending--;
+            p_notifyWorkers();
+        }
+    }
+    bool SweepRunner::p_popTask(size_t worker, size_t& trial)
+    {
+        {
+            auto& own = *queues[worker];
+            std::lock_guard<std::mutex> lock(own.mutex);
+
+            if (!own.trials.empty())
+            {
+                trial = own.trials.back();
+                own.trials.pop_back();
+                countQueued--;
+                return true;
+            }
+        }
+
+        /* Steal the oldest task of another worker */
+        for (size_t i = 1; i < queues.size(); i++)
+        {
+            auto& victim = *queues[(worker + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+
+            if (!victim.trials.empty())
+            {
+                trial = victim.trials.front();
+                victim.trials.pop_front();
+                countQueued--;
+                return true;
+            }
+        }
+
+        return false;
+    }
+    void SweepRunner::p_notifyWorkers()
+    {
+        /* Taking the mutex orders the change before a worker that is about to wait */
+        {
+            std::lock_guard<std::mutex> lock(idleMutex);
+        }
+        idleCv.notify_all();
+    }
+    void SweepRunner::p_trainRung(Trial& trial)
+    {
+        size_t countEpochs = std::min(options.countRungEpochs, options.countEpochs - trial.countEpochs);
+
+        for (size_t e = 0; e < countEpochs; e++)
+        {
+            auto epoch = static_cast<uint32_t>(trial.countEpochs);
+            double loss = 0;
+
+            for (auto row : NeuralNetwork::shuffleIndices(dataset->size(), trial.configuration.seed, epoch))
+                loss += trial.nn.train(dataset->getInput(row), dataset->getAnswer(row));
+
+            trial.loss = loss / dataset->size();
+            trial.countEpochs++;
+        }
+    }
+    bool SweepRunner::p_shouldContinue(size_t rung, double loss)
+    {
+        std::lock_guard<std::mutex> lock(rungsMutex);
+
+        if (rungLosses.size() <= rung)
+            rungLosses.resize(rung + 1);
+
+        auto& losses = rungLosses[rung];
+        losses.push_back(loss);
+
+        size_t countBetter = std::count_if(losses.begin(), losses.end(), [=](double l) { return l < loss; });
+        size_t countKept = static_cast<size_t>(std::ceil(options.keepFraction * losses.size()));
+
+        return countBetter < countKept;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include "NeuralNetwork.h"
+#include "Dataset.h"
+
+namespace NN
+{
+    /* Trains many network configurations concurrently on one shared dataset.
+       Training is split into rungs of a few epochs, each rung is a task scheduled on work-stealing
+       worker queues. After every rung a configuration whose loss is not within the best keepFraction
+       of the losses already reported at that rung is stopped (asynchronous successive halving). */
+    class SweepRunner
+    {
+    public:
+        struct Configuration
+        {
+            std::vector<int> layers;
+            double learningFactor = 0.5;
+            uint64_t seed = 0;
+            NeuralNetwork::WeightsInitialization initialization = NeuralNetwork::WeightsInitialization::XAVIER;
+        };
+
+        struct Options
+        {
+            size_t countEpochs = 100;
+            size_t countRungEpochs = 10;
+            double keepFraction = 0.5;
+            size_t countThreads = 0;    /* 0 is one per hardware thread */
+        };
+
+        struct Result
+        {
+            Configuration configuration;
+            double loss = 0;
+            size_t countEpochs = 0;
+            bool isStopped = false;
+        };
+
+    public:
+        SweepRunner(std::shared_ptr<const Dataset> dataset, Options options);
+        /* Results are ranked by loss, best first */
+        std::vector<Result> run(const std::vector<Configuration>& configurations);
+        static std::wstring formatResults(const std::vector<Result>& results);
+
+    protected:
+        struct Trial
+        {
+            Configuration configuration;
+            NeuralNetwork nn;
+            size_t countEpochs = 0;
+            double loss = 0;
+            bool isStopped = false;
+        };
+
+        struct WorkerQueue
+        {
+            std::mutex mutex;
+            std::deque<size_t> trials;
+        };
+
+        void p_worker(size_t index);
+        bool p_popTask(size_t worker, size_t& trial);
+        void p_notifyWorkers();
+        void p_trainRung(Trial& trial);
+        bool p_shouldContinue(size_t rung, double loss);
+
+    private:
+        std::shared_ptr<const Dataset> dataset;
+        Options options;
+        std::vector<std::unique_ptr<Trial>> trials;
+        std::vector<std::unique_ptr<WorkerQueue>> queues;
+        std::atomic<size_t> countPending{ 0 };
+        std::atomic<size_t> countQueued{ 0 };
+
+        /* Idle workers sleep until a task is queued or the last trial finishes */
+        std::mutex idleMutex;
+        std::condition_variable idleCv;
+        std::mutex rungsMutex;
+        std::vector<std::vector<double>> rungLosses;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,197 @@
+#include "pch.h"
+#include "TrainingPipeline.h"
+#include "NeuralNetwork.h"
+
+#include <algorithm>
+#include <cassert>
+#define expect(x) assert(x)
+
+namespace NN
+{
+    const double* TrainingPipeline::Batch::getInput(size_t index) const
+    {
+        expect(index < count);
+        return inputs + index * inputSize;
+    }
+    const double* TrainingPipeline::Batch::getAnswer(size_t index) const
+    {
+        expect(index < count);
+        return answers + index * answerSize;
+    }
+    TrainingPipeline::TrainingPipeline(const TrainingSet& trainingSet, size_t batchSize, uint64_t seed)
+        :
+        TrainingPipeline(Dataset::create(trainingSet), batchSize, seed)
+    {
+    }
+    TrainingPipeline::TrainingPipeline(std::shared_ptr<const Dataset> dataset, size_t batchSize, uint64_t seed)
+        :
+        dataset(dataset),
+        countRows(dataset->size()),
+        inputSize(dataset->getInputSize()),
+        answerSize(dataset->getAnswerSize()),
+        batchSize(batchSize),
+        seed(seed)
+    {
+        expect(countRows > 0);
+        expect(batchSize > 0);
+
+        for (auto& slot : slots)
+        {
+            slot.inputs.resize(batchSize * inputSize);
+            slot.answers.resize(batchSize * answerSize);
+        }
+
+        prefetchThread = std::thread(&TrainingPipeline::p_prefetchLoop, this);
+    }
+    TrainingPipeline::~TrainingPipeline()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            isStopping = true;
+        }
+        cv.notify_all();
+
+        prefetchThread.join();
+    }
+    size_t TrainingPipeline::size() const
+    {
+        return countRows;
+    }
+    size_t TrainingPipeline::getCountBatches() const
+    {
+        return (countRows + batchSize - 1) / batchSize;
+    }
+    void TrainingPipeline::beginEpoch(uint32_t epoch)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            p_releaseSlot();
+
+            /* The prefetch thread already works on the epoch after a fully consumed one */
+            bool isNextEpoch = isEpochStarted && epoch == this->epoch + 1 && countConsumed == getCountBatches();
+
+            if (!isNextEpoch)
+            {
+                for (auto& slot : slots)
+                    slot.isReady = false;
+
+                generation++;
+                hasEpochRequest = true;
+                requestedEpoch = epoch;
+                countTaken = 0;
+            }
+
+            this->epoch = epoch;
+            countConsumed = 0;
+            isEpochStarted = true;
+        }
+        cv.notify_all();
+    }
+    bool TrainingPipeline::nextBatch(Batch& batch)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        p_releaseSlot();
+        cv.notify_all();
+
+        if (!isEpochStarted || countConsumed == getCountBatches())
+            return false;
+
+        int slotIndex = static_cast<int>(countTaken % 2);
+        cv.wait(lock, [&] { return slots[slotIndex].isReady; });
+
+        const auto& slot = slots[slotIndex];
+        expect(slot.epoch == epoch);
+        expect(slot.batch == countConsumed);
+
+        batch.inputs = slot.inputs.data();
+        batch.answers = slot.answers.data();
+        batch.count = slot.count;
+        batch.inputSize = inputSize;
+        batch.answerSize = answerSize;
+
+        heldSlot = slotIndex;
+        countConsumed++;
+        countTaken++;
+
+        return true;
+    }
+    void TrainingPipeline::p_prefetchLoop()
+    {
+        while (true)
+        {
+            uint32_t epoch = 0;
+            size_t generation = 0;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&] { return isStopping || hasEpochRequest; });
+
+                if (isStopping)
+                    return;
+
+                hasEpochRequest = false;
+                epoch = requestedEpoch;
+                generation = this->generation;
+            }
+
+            p_prefetchEpochs(epoch, generation);
+        }
+    }
+    void TrainingPipeline::p_prefetchEpochs(uint32_t epoch, size_t generation)
+    {
+        /* Runs ahead through the following epochs until the trainer restarts it or stops */
+        for (size_t sequence = 0; ; epoch++)
+        {
+            auto order = NeuralNetwork::shuffleIndices(countRows, seed, epoch);
+
+            for (size_t b = 0; b < getCountBatches(); b++, sequence++)
+            {
+                auto& slot = slots[sequence % 2];
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cv.wait(lock, [&] { return isStopping || generation != this->generation || !slot.isReady; });
+
+                    if (isStopping || generation != this->generation)
+                        return;
+                }
+
+                /* The trainer never touches a slot that is not ready, so gathering needs no lock */
+                p_gather(slot, order, b * batchSize);
+                slot.epoch = epoch;
+                slot.batch = b;
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+
+                    /* Gathered for an epoch the trainer no longer wants */
+                    if (generation != this->generation)
+                        return;
+
+                    slot.isReady = true;
+                }
+                cv.notify_all();
+            }
+        }
+    }
+    void TrainingPipeline::p_gather(Slot& slot, const std::vector<size_t>& order, size_t firstRow)
+    {
+        slot.count = std::min(batchSize, countRows - firstRow);
+
+        for (size_t i = 0; i < slot.count; i++)
+        {
+            size_t row = order[firstRow + i];
+
+            std::copy_n(dataset->getInput(row), inputSize, slot.inputs.begin() + i * inputSize);
+            std::copy_n(dataset->getAnswer(row), answerSize, slot.answers.begin() + i * answerSize);
+        }
+    }
+    void TrainingPipeline::p_releaseSlot()
+    {
+        if (heldSlot == NO_SLOT)
+            return;
+
+        slots[heldSlot].isReady = false;
+        heldSlot = NO_SLOT;
+    }
+}
\ No newline at end of file
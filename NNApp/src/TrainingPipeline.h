@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include "Dataset.h"
+
+namespace NN
+{
+    /* Streams a dataset in shuffled batches. A prefetch thread shuffles the epoch and gathers
+       the next batch while the current one trains, and moves on to the following epoch as soon as
+       the last batch is gathered. */
+    class TrainingPipeline
+    {
+    public:
+        using TrainingSet = Dataset::TrainingSet;
+
+        /* Views into the pipeline's buffer, valid until the next call of nextBatch or beginEpoch */
+        struct Batch
+        {
+            const double* inputs = nullptr;
+            const double* answers = nullptr;
+            size_t count = 0;
+            size_t inputSize = 0;
+            size_t answerSize = 0;
+
+            const double* getInput(size_t index) const;
+            const double* getAnswer(size_t index) const;
+        };
+
+    public:
+        TrainingPipeline(const TrainingSet& trainingSet, size_t batchSize, uint64_t seed);
+        TrainingPipeline(std::shared_ptr<const Dataset> dataset, size_t batchSize, uint64_t seed);
+        TrainingPipeline(const TrainingPipeline&) = delete;
+        TrainingPipeline& operator=(const TrainingPipeline&) = delete;
+        ~TrainingPipeline();
+        size_t size() const;
+        size_t getCountBatches() const;
+        void beginEpoch(uint32_t epoch);
+        bool nextBatch(Batch& batch);
+
+    protected:
+        struct Slot
+        {
+            std::vector<double> inputs;
+            std::vector<double> answers;
+            size_t count = 0;
+            uint32_t epoch = 0;
+            size_t batch = 0;
+            bool isReady = false;
+        };
+
+        void p_prefetchLoop();
+        void p_prefetchEpochs(uint32_t epoch, size_t generation);
+        void p_gather(Slot& slot, const std::vector<size_t>& order, size_t firstRow);
+        void p_releaseSlot();
+
+    private:
+        static constexpr int NO_SLOT = -1;
+
+        std::shared_ptr<const Dataset> dataset;
+        size_t countRows = 0;
+        size_t inputSize = 0;
+        size_t answerSize = 0;
+        size_t batchSize = 0;
+        uint64_t seed = 0;
+
+        /* Double buffering: the trainer holds one slot while the prefetch thread fills the other,
+           the n-th batch since the last restart goes to slot n % 2 whatever its epoch */
+        Slot slots[2];
+        int heldSlot = NO_SLOT;
+        uint32_t epoch = 0;
+        size_t countConsumed = 0;
+        size_t countTaken = 0;
+        bool isEpochStarted = false;
+
+        /* Restarts the prefetch thread when the trainer asks for another epoch than the next one */
+        bool hasEpochRequest = false;
+        uint32_t requestedEpoch = 0;
+        size_t generation = 0;
+        bool isStopping = false;
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::thread prefetchThread;
+    };
+}
\ No newline at end of file